@@ -187,6 +187,8 @@ namespace comm {
         void amfence();
         void reply(int tag, void *p, size_t size, aminfo *info,
                    process_config& config);
+        void reply(int tag, void *p, size_t size, void *p2, size_t size2,
+                   aminfo *info, process_config& config);
         bool amhandle(int r, int tag, int pid, process_config& config);
         void ampoll(process_config& config);
 
@@ -141,6 +141,10 @@ namespace comm {
         T fetch_and_add(T *dst, T value, int target)
         { return c_.fetch_and_add(dst, value, target, *config_); }
 
+        template <class T>
+        void fetch_and_add_nbi(T *dst, T *value, T *result, int target)
+        { c_.fetch_and_add_nbi(dst, value, result, target, *config_); }
+
         void lock_init(lock_t* lp)
         { c_.lock_init(lp, *config_); }
 
@@ -164,6 +168,10 @@ namespace comm {
         void reply(int tag, void *p, size_t size, aminfo *info)
         { c_.reply(tag, p, size, info, *config_); }
 
+        void reply(int tag, void *p, size_t size, void *p2, size_t size2,
+                   aminfo *info)
+        { c_.reply(tag, p, size, p2, size2, info, *config_); }
+
 #if 0
         bool handle(int r, int tag, int pid)
         { return c_.handle(r, tag, pid, *config_); }
@@ -99,6 +99,9 @@ namespace comm {
 
         void reply(int tag, void *p, size_t size, aminfo *info,
                    process_config& config);
+
+        void reply(int tag, void *p, size_t size, void *p2, size_t size2,
+                   aminfo *info, process_config& config);
     };
 
 }
@@ -53,6 +53,8 @@ namespace comm {
 
     template <class T>
     T fetch_and_add(T *dst, T value, pid_t target);
+    template <class T>
+    void fetch_and_add_nbi(T *dst, T *value, T *result, pid_t target);
 
     void fence();
     void poll();
@@ -62,6 +64,7 @@ namespace comm {
 
     void reg_put(int id, void *dst, void *src, size_t size, pid_t target);
     void reg_get(int id, void *dst, void *src, size_t size, pid_t target);
+    void reg_get_nbi(int id, void *dst, void *src, size_t size, pid_t target);
 
     void barrier();
     bool barrier_try();
@@ -84,9 +87,15 @@ namespace comm {
 
     void amrequest(int tag, void *p, size_t size, int target);
     void amreply(int tag, void *p, size_t size, aminfo *info);
+    // replies with [p, p + size) followed by [p2, p2 + size2)
+    void amreply(int tag, void *p, size_t size, void *p2, size_t size2,
+                 aminfo *info);
 
     size_t get_server_mod();
 
+    int required_thread_level();
+    bool has_progress_thread();
+
     void print_options(FILE *f);
 
 
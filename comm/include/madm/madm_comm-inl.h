@@ -94,6 +94,12 @@ namespace comm {
         return g.comm->fetch_and_add(dst, value, target);
     }
 
+    template <class T>
+    inline void fetch_and_add_nbi(T *dst, T *value, T *result, pid_t target)
+    {
+        g.comm->fetch_and_add_nbi(dst, value, result, target);
+    }
+
     inline void lock_init(lock_t* lp)
     {
         g.comm->lock_init(lp);
@@ -12,6 +12,7 @@
 #include <cstdint>
 #include <cerrno>
 #include <vector>
+#include <pthread.h>
 
 namespace madi {
 namespace comm {
@@ -23,6 +24,14 @@ namespace comm {
 
     typedef allocator<comm_memory> comm_allocator;
 
+    struct progress_thread_arg {
+        volatile int done;
+        MPI_Comm comm;
+        bool yield;         // yield the core between probes
+    public:
+        progress_thread_arg() : done(0), comm(MPI_COMM_NULL), yield(true) {}
+    };
+
     // base communication system for Fujitsu MPI
     class comm_base : noncopyable {
 
@@ -32,6 +41,20 @@ namespace comm {
         volatile long *value_buf_;
         process_config native_config_;
 
+        // active messages over two-sided MPI
+        amhandler_t handler_;
+        MPI_Comm am_comm_;
+        bool am_handling_;
+        std::vector<uint8_t> am_recvbuf_;
+        std::vector<std::vector<uint8_t>> am_sendbufs_;  // send buffer pool
+        std::vector<size_t> am_free_sendbufs_;
+        std::vector<MPI_Request> am_requests_;         // sends in flight
+        std::vector<size_t> am_request_bufs_;
+
+        // progress thread (MADM_PROGRESS_THREAD)
+        pthread_t progress_thread_;
+        progress_thread_arg progress_arg_;
+
     public:
         comm_base(int& argc, char **& argv, amhandler_t handler);
         ~comm_base();
@@ -94,18 +117,28 @@ namespace comm {
         template <class T>
         T fetch_and_add(T *dst, T value, int target, process_config& config);
 
+        // value and result must be alive until fence()
+        template <class T>
+        void fetch_and_add_nbi(T *dst, T *value, T *result, int target,
+                               process_config& config);
+
         void lock_init(lock_t* lp, process_config& config);
         bool trylock(lock_t* lp, int target, process_config& config);
         void lock(lock_t* lp, int target, process_config& config);
         void unlock(lock_t* lp, int target, process_config& config);
 
         void request(int tag, void *p, size_t size, int pid,
-                     process_config& config)
-        { MADI_UNDEFINED; }
-
+                     process_config& config);
         void reply(int tag, void *p, size_t size, aminfo *info,
-                   process_config& config)
-        { MADI_UNDEFINED; }
+                   process_config& config);
+        void reply(int tag, void *p, size_t size, void *p2, size_t size2,
+                   aminfo *info, process_config& config);
+
+    private:
+        void am_send(int tag, void *p, size_t size, void *p2, size_t size2,
+                     int pid);
+        void am_complete_sends();
+        void am_handle(process_config& config);
     };
 
 }
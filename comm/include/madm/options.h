@@ -13,9 +13,16 @@ namespace comm {
         size_t server_mod;              // modulo number that determines
                                         // communication server processes
         size_t n_max_sends;             // a parameter for active messaging
+        size_t am_max_handles;          // max # of active messages handled
+                                        //   by a single poll (MPI-3)
         size_t gasnet_poll_thread;      // spawn a poll thread 
                                         //   for GASNet active messaging or not
         size_t gasnet_segment_size;     // RDMA segment size passed to GASNet
+        size_t progress_thread;         // spawn a thread that makes progress
+                                        //   on RMA operations (MPI-3)
+        int progress_thread_core;       // core to which the progress thread
+                                        //   is bound (-1: not bound, and
+                                        //   it yields between probes)
         int debug_level;                // debug level (enabled only if
                                         //   configured with debug option)
     };
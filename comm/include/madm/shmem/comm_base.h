@@ -77,6 +77,10 @@ namespace comm {
                    process_config& config)
         { MADI_UNDEFINED; }
 
+        void reply(int tag, void *p, size_t size, void *p2, size_t size2,
+                   aminfo *info, process_config& config)
+        { MADI_UNDEFINED; }
+
     private:
         void do_put(int memid, void *dst, void *src, size_t size,
                     int target, process_config& config);
@@ -13,6 +13,12 @@ namespace comm {
             return __sync_bool_compare_and_swap(dst, old_v, new_v);
         }
 
+        static bool compare_and_swap(volatile uint64_t *dst, uint64_t old_v,
+                                     uint64_t new_v)
+        {
+            return __sync_bool_compare_and_swap(dst, old_v, new_v);
+        }
+
         static void swap(volatile int *dst, int *src)
         {
             int new_v = *src;
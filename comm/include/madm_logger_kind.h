@@ -22,6 +22,7 @@ namespace madi {
             TASKQ_PUSH,
             TASKQ_POP,
             TASKQ_STEAL,
+            TASKQ_STEAL_LOCKFREE,
             TASKQ_EMPTY,
 
             FUTURE_POOL_SYNC,
@@ -45,6 +46,8 @@ namespace madi {
             STEAL_SUCCESS,
             STEAL_FAIL,
             STEAL_TASK_COPY,
+            STEAL_BACKOFF_SKIP,
+            STEAL_HINT,
 
             OTHER,
             __N_KINDS,
@@ -86,6 +89,7 @@ namespace madi {
                 case kind::TASKQ_PUSH:              return "taskq_push";
                 case kind::TASKQ_POP:               return "taskq_pop";
                 case kind::TASKQ_STEAL:             return "taskq_steal";
+                case kind::TASKQ_STEAL_LOCKFREE:    return "taskq_steal_lockfree";
                 case kind::TASKQ_EMPTY:             return "taskq_empty";
 
                 case kind::FUTURE_POOL_SYNC:        return "future_pool_sync";
@@ -106,6 +110,8 @@ namespace madi {
                 case kind::STEAL_SUCCESS:           return "steal_success";
                 case kind::STEAL_FAIL:              return "steal_fail";
                 case kind::STEAL_TASK_COPY:         return "steal_task_copy";
+                case kind::STEAL_BACKOFF_SKIP:      return "steal_backoff_skip";
+                case kind::STEAL_HINT:              return "steal_hint";
 
                 case kind::COLLECT_FUTURE:          return "collect_future";
                 case kind::COLLECT_SUSPENDED:       return "collect_suspended";
@@ -9,6 +9,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <climits>
+#include <vector>
 
 #include <mpi-ext.h>
 
@@ -347,6 +348,18 @@ namespace comm {
         
         g_amprof->reply.end();
     }
+
+    template <class CB>
+    void ampeer<CB>::reply(int tag, void *p, size_t size, void *p2,
+                           size_t size2, aminfo *info, process_config& config)
+    {
+        // a message is sent from a contiguous buffer
+        std::vector<uint8_t> buf(size + size2);
+        memcpy(buf.data(), p, size);
+        memcpy(buf.data() + size, p2, size2);
+
+        reply(tag, buf.data(), buf.size(), info, config);
+    }
     
     namespace {
         bool amhandle_default(int tag, int pid, void *data, size_t size,
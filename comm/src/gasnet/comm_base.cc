@@ -8,6 +8,8 @@
 #include "../gasnet_ext.h"
 #include <mpi.h>
 #include <type_traits>
+#include <vector>
+#include <cstring>
 
 #define MADI_CB_DEBUG  0
 
@@ -594,6 +596,17 @@ namespace comm {
                               tag, pid);
     }
 
+    void comm_base::reply(int tag, void *p, size_t size, void *p2,
+                          size_t size2, aminfo *info, process_config& config)
+    {
+        // a medium message is sent from a contiguous buffer
+        std::vector<uint8_t> buf(size + size2);
+        memcpy(buf.data(), p, size);
+        memcpy(buf.data() + size, p2, size2);
+
+        reply(tag, buf.data(), buf.size(), info, config);
+    }
+
 
     // template instantiation for put_value
     template void comm_base::put_value(int *, int, int, process_config&);
@@ -140,6 +140,13 @@ namespace comm {
         g.comm->reg_get(id, dst, src, size, target);
     }
 
+    void reg_get_nbi(int id, void *dst, void *src, size_t size, pid_t target)
+    {
+        MADI_ASSERT(0 <= target && target < get_n_procs());
+
+        g.comm->reg_get_nbi(id, dst, src, size, target);
+    }
+
     void barrier()
     {
         g.comm->barrier();
@@ -194,11 +201,31 @@ namespace comm {
         g.comm->reply(tag, p, size, info);
     }
 
+    void amreply(int tag, void *p, size_t size, void *p2, size_t size2,
+                 aminfo *info)
+    {
+        g.comm->reply(tag, p, size, p2, size2, info);
+    }
+
     size_t get_server_mod()
     {
         return options.server_mod;
     }
 
+    // called before MPI is initialized
+    int required_thread_level()
+    {
+        options_initialize();
+
+        return options.progress_thread ? MPI_THREAD_MULTIPLE
+                                       : MPI_THREAD_SINGLE;
+    }
+
+    bool has_progress_thread()
+    {
+        return options.progress_thread;
+    }
+
     void print_options(FILE *f)
     {
         madi::comm::options_print(f);
@@ -6,6 +6,7 @@
 
 #include <cstring>
 #include <mpi.h>
+#include <sched.h>
 
 #define MADI_CB_DEBUG  0
 
@@ -22,11 +23,34 @@
 namespace madi {
 namespace comm {
 
+    void * progress_thread_start(void *p)
+    {
+        progress_thread_arg& arg = *reinterpret_cast<progress_thread_arg *>(p);
+
+        // probing makes progress on RMA operations targeting this process
+        // (see comm_base::poll). a thread that is not bound to a core of
+        // its own yields it to the worker of the process between probes.
+        while (!arg.done) {
+            int flag;
+            MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, arg.comm, &flag,
+                       MPI_STATUS_IGNORE);
+
+            if (arg.yield)
+                sched_yield();
+        }
+
+        return NULL;
+    }
+
     comm_base::comm_base(int& argc, char **& argv, amhandler_t handler)
         : cmr_(NULL)
         , comm_alc_(NULL)
         , value_buf_(NULL)
         , native_config_()
+        , handler_(handler)
+        , am_comm_(MPI_COMM_NULL)
+        , am_handling_(false)
+        , progress_arg_()
     {
         cmr_ = new comm_memory(native_config_);
 
@@ -34,10 +58,55 @@ namespace comm {
         comm_alc_ = new allocator<comm_memory>(cmr_, native_config_);
 
         value_buf_ = (long *)comm_alc_->allocate<true>(sizeof(long), native_config_);
+
+        // active messages use their own communicator so as not to be
+        // matched with the messages of the user and collectives
+        MPI_Comm_dup(native_config_.comm(), &am_comm_);
+
+        if (options.progress_thread) {
+            int provided;
+            MPI_Query_thread(&provided);
+
+            if (provided != MPI_THREAD_MULTIPLE)
+                MADI_SPMD_DIE("MADM_PROGRESS_THREAD requires "
+                              "MPI_THREAD_MULTIPLE");
+
+            MPI_Comm_dup(native_config_.comm(), &progress_arg_.comm);
+            progress_arg_.yield = (options.progress_thread_core < 0);
+
+            pthread_create(&progress_thread_, NULL,
+                           progress_thread_start,
+                           reinterpret_cast<void *>(&progress_arg_));
+
+            int core = options.progress_thread_core;
+            if (core >= 0) {
+                cpu_set_t cpuset;
+                CPU_ZERO(&cpuset);
+                CPU_SET(core, &cpuset);
+
+                int r = pthread_setaffinity_np(progress_thread_,
+                                               sizeof(cpuset), &cpuset);
+                if (r != 0)
+                    MADI_DIE("cannot bind the progress thread "
+                             "to core %d", core);
+            }
+        }
     }
 
     comm_base::~comm_base()
     {
+        if (options.progress_thread) {
+            progress_arg_.done = 1;
+            pthread_join(progress_thread_, NULL);
+
+            MPI_Comm_free(&progress_arg_.comm);
+        }
+
+        // every request has been replied to by this point
+        MPI_Waitall((int)am_requests_.size(), am_requests_.data(),
+                    MPI_STATUSES_IGNORE);
+        MPI_Comm_free(&am_comm_);
+
         comm_alc_->deallocate((void *)value_buf_);
         delete comm_alc_;
         delete cmr_;
@@ -242,8 +311,16 @@ namespace comm {
         // References:
         // * https://lists.mpich.org/mailman/htdig/discuss/2014-September/001944.html
         // * https://community.intel.com/t5/Intel-oneAPI-HPC-Toolkit/MPI-polling-passive-rma-operations/td-p/1052066
-        int flag;
-        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, MPI_STATUS_IGNORE);
+        //
+        // The probe for active messages plays the same role, and a progress
+        // thread (MADM_PROGRESS_THREAD) does it instead if enabled.
+        if (handler_ != nullptr) {
+            am_complete_sends();
+            am_handle(config);
+        } else if (!options.progress_thread) {
+            int flag;
+            MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, MPI_STATUS_IGNORE);
+        }
 
         sync();
 
@@ -251,6 +328,120 @@ namespace comm {
         return 0;
     }
 
+    void comm_base::request(int tag, void *p, size_t size, int pid,
+                            process_config& config)
+    {
+        am_send(tag, p, size, NULL, 0, config.native_pid(pid));
+    }
+
+    void comm_base::reply(int tag, void *p, size_t size, aminfo *info,
+                          process_config& config)
+    {
+        reply(tag, p, size, NULL, 0, info, config);
+    }
+
+    void comm_base::reply(int tag, void *p, size_t size, void *p2,
+                          size_t size2, aminfo *info, process_config& config)
+    {
+        MADI_ASSERT(!info->replied);
+
+        am_send(tag, p, size, p2, size2, info->initiator);
+        info->replied = true;
+    }
+
+    void comm_base::am_send(int tag, void *p, size_t size, void *p2,
+                            size_t size2, int pid)
+    {
+        am_complete_sends();
+
+        // the message is copied to a pooled buffer, so that the caller
+        // can reuse p and p2 and the send can be completed lazily at poll
+        size_t id;
+        if (am_free_sendbufs_.empty()) {
+            id = am_sendbufs_.size();
+            am_sendbufs_.emplace_back();
+        } else {
+            id = am_free_sendbufs_.back();
+            am_free_sendbufs_.pop_back();
+        }
+
+        std::vector<uint8_t>& buf = am_sendbufs_[id];
+        if (buf.size() < size + size2)
+            buf.resize(size + size2);
+
+        memcpy(buf.data(), p, size);
+        if (size2 > 0)
+            memcpy(buf.data() + size, p2, size2);
+
+        MPI_Request req;
+        MPI_Isend(buf.data(), (int)(size + size2), MPI_BYTE, pid, tag,
+                  am_comm_, &req);
+
+        am_requests_.push_back(req);
+        am_request_bufs_.push_back(id);
+    }
+
+    void comm_base::am_complete_sends()
+    {
+        size_t i = 0;
+        while (i < am_requests_.size()) {
+            int flag;
+            MPI_Test(&am_requests_[i], &flag, MPI_STATUS_IGNORE);
+
+            if (flag) {
+                am_free_sendbufs_.push_back(am_request_bufs_[i]);
+
+                am_requests_[i] = am_requests_.back();
+                am_request_bufs_[i] = am_request_bufs_.back();
+                am_requests_.pop_back();
+                am_request_bufs_.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    void comm_base::am_handle(process_config& config)
+    {
+        // handlers are not nested even if they call poll()
+        if (am_handling_) {
+            int flag;
+            MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, am_comm_, &flag, MPI_STATUS_IGNORE);
+            return;
+        }
+
+        am_handling_ = true;
+
+        // handle the queued messages (up to MADM_AM_MAX_HANDLES) at once
+        for (size_t n = 0; n < options.am_max_handles; n++) {
+            int flag;
+            MPI_Status status;
+            MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, am_comm_, &flag, &status);
+
+            if (!flag)
+                break;
+
+            int size;
+            MPI_Get_count(&status, MPI_BYTE, &size);
+
+            if (am_recvbuf_.size() < (size_t)size)
+                am_recvbuf_.resize(size);
+
+            MPI_Recv(am_recvbuf_.data(), size, MPI_BYTE, status.MPI_SOURCE,
+                     status.MPI_TAG, am_comm_, MPI_STATUS_IGNORE);
+
+            aminfo info;
+            info.initiator = status.MPI_SOURCE;
+            info.replybuf = NULL;
+            info.replied = false;
+
+            handler_(status.MPI_TAG, config.abstract_pid(status.MPI_SOURCE),
+                     am_recvbuf_.data(), size, &info);
+        }
+
+        am_handling_ = false;
+    }
+
     void comm_base::fence()
     {
         logger::begin_data bd = logger::begin_event<logger::kind::COMM_FENCE>();
@@ -312,6 +503,30 @@ namespace comm {
     template unsigned long comm_base::fetch_and_add<unsigned long>(unsigned long *, unsigned long, int,
                                                                    process_config&);
 
+    template <class T>
+    void comm_base::fetch_and_add_nbi(T *dst, T *value, T *result,
+                                      int target, process_config& config)
+    {
+        logger::begin_data bd = logger::begin_event<logger::kind::COMM_FETCH_AND_ADD>();
+
+        MPI_Win win;
+        size_t target_disp;
+        cmr_->translate(-1, dst, sizeof(T), target, &target_disp, &win);
+
+        MPI_Datatype type = mpi_type<T>();
+
+        MPI_Fetch_and_op(value, result, type, target, target_disp,
+                         MPI_SUM, win);
+
+        logger::end_event<logger::kind::COMM_FETCH_AND_ADD>(bd, target);
+    }
+
+    template void comm_base::fetch_and_add_nbi<long>(long *, long *, long *,
+                                                     int, process_config&);
+    template void comm_base::fetch_and_add_nbi<unsigned long>(
+        unsigned long *, unsigned long *, unsigned long *, int,
+        process_config&);
+
     void comm_base::lock_init(lock_t* lp, process_config& config)
     {
         *lp = 0;
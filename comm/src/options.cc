@@ -14,8 +14,11 @@ namespace comm {
         MADI_DEFAULT_N_CORES,           // n_procs_per_node
         MADI_DEFAULT_SERVER_MOD,        // server_mod
         10,            // n_max_sends (heuristics: ~ # of cores within a node)
+        8,                              // am_max_handles
         0,                              // gasnet_poll_thread
         0,                              // gasnet_segment_size
+        0,                              // progress_thread
+        -1,                             // progress_thread_core
         5,             // debug level (only if configured with debug option)
     };
 
@@ -55,6 +58,17 @@ namespace comm {
         set_option("MADM_GASNET_POLL_THREAD", &options.gasnet_poll_thread);
         set_option("MADM_GASNET_SEGMENT_SIZE", &options.gasnet_segment_size);
         set_option("MADM_DEBUG_LEVEL", &options.debug_level);
+        set_option("MADM_AM_MAX_HANDLES", &options.am_max_handles);
+        set_option("MADM_PROGRESS_THREAD", &options.progress_thread);
+        set_option("MADM_PROGRESS_THREAD_CORE", &options.progress_thread_core);
+
+#if MADI_COMM_LAYER != MADI_COMM_LAYER_MPI3
+        // other layers make progress by themselves or by their own threads
+        options.progress_thread = 0;
+#endif
+
+        if (options.am_max_handles < 1)
+            options.am_max_handles = 1;
 
         // validate server_mod
         MADI_CHECK(options.server_mod <= options.n_procs_per_node);
@@ -73,13 +87,19 @@ namespace comm {
                 ", MADM_SERVER_MOD = %zu"
                 ", MADM_GASNET_POLL_THREAD = %zd"
                 ", MADM_GASNET_SEGMENT_SIZE = %zu"
+                ", MADM_AM_MAX_HANDLES = %zu"
+                ", MADM_PROGRESS_THREAD = %zu"
+                ", MADM_PROGRESS_THREAD_CORE = %d"
                 "\n",
                 MADI_DEBUG_LEVEL,
                 options.debug_level,
                 options.n_procs_per_node,
                 options.server_mod,
                 options.gasnet_poll_thread,
-                options.gasnet_segment_size);
+                options.gasnet_segment_size,
+                options.am_max_handles,
+                options.progress_thread,
+                options.progress_thread_core);
 
     }
 }
@@ -311,7 +311,7 @@ void real_main(int argc, char **argv)
                n, n_procs, server_mod);
         uth::print_options(stdout);
     }
-    uth::barrier();
+    uth::logger_clear();
 
     double t0 = uth::time();
 
@@ -344,6 +344,8 @@ void real_main(int argc, char **argv)
                time, nodes, throughput, throughput / (double)n_procs);
 
     }
+
+    uth::logger_print_stat();
 }
 
 int main(int argc, char **argv)
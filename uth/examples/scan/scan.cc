@@ -0,0 +1,177 @@
+#include <uth.h>
+#include <uth-dtbb.h>
+#include <madm_comm.h>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+namespace uth = madm::uth;
+
+// inclusive prefix sums of an array distributed in blocks,
+// compared with a sequential scan of a local array
+
+static long g_n;
+static long g_block;
+static long **g_in;
+static long **g_out;
+
+static long value_of(long i)
+{
+    return (i * 7 + 3) % 10;
+}
+
+// get/put elements [lo, hi) of a distributed array
+template <class F>
+static void for_each_block(long lo, long hi, F f)
+{
+    while (lo < hi) {
+        long owner = lo / g_block;
+        long end = std::min(hi, (owner + 1) * g_block);
+
+        f(owner, lo - owner * g_block, end - lo);
+        lo = end;
+    }
+}
+
+static void get_range(long *buf, long **array, long lo, long hi)
+{
+    for_each_block(lo, hi, [&] (long owner, long offset, long size) {
+        madi::comm::get(buf, array[owner] + offset, sizeof(long) * size,
+                        owner);
+        buf += size;
+    });
+}
+
+static void put_range(long **array, long *buf, long lo, long hi)
+{
+    for_each_block(lo, hi, [&] (long owner, long offset, long size) {
+        madi::comm::put(array[owner] + offset, buf, sizeof(long) * size,
+                        owner);
+        buf += size;
+    });
+}
+
+static long sum_chunk(long lo, long hi)
+{
+    std::vector<long> buf(hi - lo);
+    get_range(buf.data(), g_in, lo, hi);
+
+    long s = 0;
+    for (long i = 0; i < hi - lo; i++)
+        s += buf[i];
+    return s;
+}
+
+static void scan_chunk(long lo, long hi, long prefix)
+{
+    std::vector<long> buf(hi - lo);
+    get_range(buf.data(), g_in, lo, hi);
+
+    long s = prefix;
+    for (long i = 0; i < hi - lo; i++) {
+        s += buf[i];
+        buf[i] = s;
+    }
+
+    put_range(g_out, buf.data(), lo, hi);
+}
+
+static long scan_seq(std::vector<long>& a)
+{
+    long s = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        s += a[i];
+        a[i] = s;
+    }
+    return s;
+}
+
+static long scan_par(long grainsize)
+{
+    return uth::dtbb::parallel_scan(0L, g_n, grainsize, 0L,
+        [] (long lo, long hi) { return sum_chunk(lo, hi); },
+        [] (long lo, long hi, long prefix) { scan_chunk(lo, hi, prefix); },
+        [] (long x, long y) { return x + y; });
+}
+
+void real_main(int argc, char **argv)
+{
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "usage: %s N GRAINSIZE [ITERS]\n", argv[0]);
+        exit(1);
+    }
+    long n = atol(argv[1]);
+    long grainsize = atol(argv[2]);
+    int iters = (argc == 4) ? atoi(argv[3]) : 3;
+
+    uth::pid_t me = uth::get_pid();
+    size_t n_procs = uth::get_n_procs();
+
+    g_n = n;
+    g_block = std::max(1L, (n + (long)n_procs - 1) / (long)n_procs);
+    g_in = madi::comm::coll_rma_malloc<long>(g_block);
+    g_out = madi::comm::coll_rma_malloc<long>(g_block);
+
+    for (long i = 0; i < g_block; i++) {
+        g_in[me][i] = value_of(me * g_block + i);
+        g_out[me][i] = 0;
+    }
+
+    if (me == 0) {
+        printf("program = scan, N = %ld, grainsize = %ld, np = %zu\n",
+               n, grainsize, n_procs);
+        uth::print_options(stdout);
+    }
+
+    uth::barrier();
+
+    if (me == 0) {
+        std::vector<long> expected(n);
+        double t_seq = 1e30;
+        for (int it = 0; it < iters; it++) {
+            for (long i = 0; i < n; i++)
+                expected[i] = value_of(i);
+
+            double t0 = uth::time();
+            scan_seq(expected);
+            double t1 = uth::time();
+
+            t_seq = std::min(t_seq, t1 - t0);
+        }
+
+        double t_par = 1e30;
+        long total = 0;
+        for (int it = 0; it < iters; it++) {
+            double t0 = uth::time();
+            total = scan_par(grainsize);
+            double t1 = uth::time();
+
+            t_par = std::min(t_par, t1 - t0);
+        }
+
+        std::vector<long> result(n);
+        get_range(result.data(), g_out, 0, n);
+
+        if (n > 0 && (result != expected || total != expected[n - 1])) {
+            printf("result = error,\n");
+            exit(1);
+        }
+
+        printf("result = %ld,\n", total);
+        printf("time = %.6lf, seq_time = %.6lf, speedup = %.3lf,\n"
+               "throughput = %.3lf Melements/s\n",
+               t_par, t_seq, t_seq / t_par, 1e-6 * (double)n / t_par);
+    }
+
+    uth::barrier();
+
+    madi::comm::coll_rma_free(g_out);
+    madi::comm::coll_rma_free(g_in);
+}
+
+int main(int argc, char **argv)
+{
+    uth::start(real_main, argc, argv);
+    return 0;
+}
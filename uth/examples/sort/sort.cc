@@ -0,0 +1,132 @@
+#include <uth.h>
+#include <uth-dtbb.h>
+#include <madm_comm.h>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+namespace uth = madm::uth;
+
+// sorts random keys in an array distributed in blocks,
+// compared with std::sort of a local array
+
+static long g_n;
+static long g_block;
+static uint64_t **g_keys;
+static uint64_t **g_tmp;
+
+static uint64_t key_of(long i, int iter)
+{
+    // splitmix64
+    uint64_t x = (uint64_t)i + ((uint64_t)iter << 40);
+    x += 0x9e3779b97f4a7c15UL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+    return x ^ (x >> 31);
+}
+
+static void fill_keys(uth::pid_t me, int iter)
+{
+    long lo = std::min(g_n, (long)me * g_block);
+    long hi = std::min(g_n, lo + g_block);
+
+    for (long i = lo; i < hi; i++)
+        g_keys[me][i - lo] = key_of(i, iter);
+}
+
+static bool check_keys(int iter)
+{
+    std::vector<uint64_t> keys(g_n);
+    for (long lo = 0; lo < g_n; lo += g_block) {
+        long hi = std::min(g_n, lo + g_block);
+        madi::comm::get(keys.data() + lo, g_keys[lo / g_block],
+                        sizeof(uint64_t) * (hi - lo), lo / g_block);
+    }
+
+    std::vector<uint64_t> expected(g_n);
+    for (long i = 0; i < g_n; i++)
+        expected[i] = key_of(i, iter);
+    std::sort(expected.begin(), expected.end());
+
+    return keys == expected;
+}
+
+static double sort_seq(int iter)
+{
+    std::vector<uint64_t> keys(g_n);
+    for (long i = 0; i < g_n; i++)
+        keys[i] = key_of(i, iter);
+
+    double t0 = uth::time();
+    std::sort(keys.begin(), keys.end());
+    double t1 = uth::time();
+
+    return t1 - t0;
+}
+
+void real_main(int argc, char **argv)
+{
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "usage: %s N [ITERS]\n", argv[0]);
+        exit(1);
+    }
+    long n = atol(argv[1]);
+    int iters = (argc == 3) ? atoi(argv[2]) : 3;
+
+    uth::pid_t me = uth::get_pid();
+    size_t n_procs = uth::get_n_procs();
+
+    g_n = n;
+    g_block = std::max(1L, (n + (long)n_procs - 1) / (long)n_procs);
+    g_keys = madi::comm::coll_rma_malloc<uint64_t>(g_block);
+    g_tmp = madi::comm::coll_rma_malloc<uint64_t>(g_block);
+
+    if (me == 0) {
+        printf("program = sort, N = %ld, np = %zu\n", n, n_procs);
+        uth::print_options(stdout);
+    }
+
+    double t_seq = 1e30;
+    double t_par = 1e30;
+
+    for (int it = 0; it < iters; it++) {
+        fill_keys(me, it);
+
+        uth::barrier();
+
+        if (me == 0) {
+            t_seq = std::min(t_seq, sort_seq(it));
+
+            double t0 = uth::time();
+            uth::dtbb::parallel_sort(g_keys, g_tmp, g_block, n);
+            double t1 = uth::time();
+
+            t_par = std::min(t_par, t1 - t0);
+
+            if (!check_keys(it)) {
+                printf("result = error,\n");
+                exit(1);
+            }
+        }
+
+        uth::barrier();
+    }
+
+    if (me == 0) {
+        printf("result = OK,\n");
+        printf("time = %.6lf, seq_time = %.6lf, speedup = %.3lf,\n"
+               "throughput = %.3lf Mkeys/s\n",
+               t_par, t_seq, t_seq / t_par, 1e-6 * (double)n / t_par);
+    }
+
+    madi::comm::coll_rma_free(g_tmp);
+    madi::comm::coll_rma_free(g_keys);
+}
+
+int main(int argc, char **argv)
+{
+    uth::start(real_main, argc, argv);
+    return 0;
+}
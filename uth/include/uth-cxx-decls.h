@@ -27,6 +27,12 @@ namespace uth {
     double time();
 
     void print_options(FILE *f);
+
+    // logger statistics (available with --enable-logger).
+    // both are collective; logger_print_stat prints the statistics of
+    // the events since the last logger_clear at process 0.
+    void logger_clear();
+    void logger_print_stat();
 }
 }
 
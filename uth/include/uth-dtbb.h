@@ -1,6 +1,15 @@
 
 #include "uth/future.h"
+#include "uth/range_task.h"
 #include <madm_debug.h>
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace madm {
 namespace uth {
@@ -8,16 +17,94 @@ namespace dtbb {
 
     // these functions have similar semantics to the functions in Intel TBB
 
+    // the tag of the splitting constructors of ranges
+    struct split {};
+
+    // [begin, end) divisible into halves of more than grainsize elements
+    template <class Value>
+    class blocked_range {
+    private:
+        Value begin_;
+        Value end_;
+        size_t grainsize_;
+
+    public:
+        blocked_range(Value begin, Value end, size_t grainsize = 1);
+
+        // take the second half of r, leaving the first half in r
+        blocked_range(blocked_range& r, split);
+
+        Value begin() const { return begin_; }
+        Value end() const { return end_; }
+        size_t size() const { return end_ - begin_; }
+        size_t grainsize() const { return grainsize_; }
+
+        bool empty() const { return !(begin_ < end_); }
+        // size() of a reversed range is huge, so it is never divided
+        bool is_divisible() const { return !empty() && size() > grainsize_; }
+    };
+
+    // a range split along the dimension that is larger
+    // relative to its grainsize
+    template <class RowValue, class ColValue = RowValue>
+    class blocked_range2d {
+    private:
+        blocked_range<RowValue> rows_;
+        blocked_range<ColValue> cols_;
+
+    public:
+        blocked_range2d(RowValue row_begin, RowValue row_end,
+                        size_t row_grainsize,
+                        ColValue col_begin, ColValue col_end,
+                        size_t col_grainsize);
+
+        blocked_range2d(RowValue row_begin, RowValue row_end,
+                        ColValue col_begin, ColValue col_end);
+
+        blocked_range2d(blocked_range2d& r, split);
+
+        const blocked_range<RowValue>& rows() const { return rows_; }
+        const blocked_range<ColValue>& cols() const { return cols_; }
+
+        bool empty() const { return rows_.empty() || cols_.empty(); }
+        bool is_divisible() const
+        { return rows_.is_divisible() || cols_.is_divisible(); }
+    };
+
+    // splits a range into a few chunks per process first, and splits
+    // the rest of a range further only when a thief has taken it.
+    // a range is not divided more than needed if no one steals.
+    class auto_partitioner {
+    public:
+        int initial_depth() const;
+        int stolen_depth() const { return 2; }
+    };
+
+    // splits a range down to its grainsize
+    class simple_partitioner {
+    public:
+        int initial_depth() const { return INT_MAX / 2; }
+        int stolen_depth() const { return 0; }
+    };
+
     template <class Iterator, class F>
     void parallel_for(Iterator first, Iterator last, F&& f);
 
     template <class Index, class F>
     void parallel_for(Index first, Index last, Index grainsize, F&& f);
 
-    // TODO: implement
+    // f(range) is called for each chunk of the range
     template <class Range, class F>
     void parallel_for(const Range& range, F&& f);
 
+    template <class Range, class F>
+    void parallel_for(const Range& range, F&& f,
+                      const auto_partitioner& partitioner);
+
+    template <class Range, class F>
+    void parallel_for(const Range& range, F&& f,
+                      const simple_partitioner& partitioner);
+
     // Iterator: integer is OK
     // FIXME: declaring 'Reduce&&' is reported as a compile error at
     //        gcc-4.7.2 or gcc-4.9.1 (clang can compile it)
@@ -25,38 +112,86 @@ namespace dtbb {
     T parallel_reduce(Iterator first, Iterator last, const T& init, 
                       F&& f, Reduce reduce);
 
-    // TODO: implement
+    // f(range, init) returns the result of a chunk of the range
     template <class Range, class T, class F, class Reduce>
-    T parallel_reduce(const Range& range, const T&& init, 
-                      F&& f, Reduce&& reduce);
+    T parallel_reduce(const Range& range, const T& init,
+                      F&& f, Reduce reduce);
+
+    template <class Range, class T, class F, class Reduce>
+    T parallel_reduce(const Range& range, const T& init,
+                      F&& f, Reduce reduce,
+                      const auto_partitioner& partitioner);
+
+    template <class Range, class T, class F, class Reduce>
+    T parallel_reduce(const Range& range, const T& init,
+                      F&& f, Reduce reduce,
+                      const simple_partitioner& partitioner);
+
+    // prefix sums over [first, last) in two passes. f(lo, hi) returns
+    // the reduction of a chunk, and then scan(lo, hi, prefix) is called
+    // for each chunk with the reduction of the elements before lo
+    // (identity for the first chunk). returns the reduction of the range.
+    template <class Index, class T, class F, class Scan, class Reduce>
+    T parallel_scan(Index first, Index last, Index grainsize,
+                    const T& identity, F&& f, Scan&& scan, Reduce reduce);
+
+    // sorts n elements of an array distributed by
+    // coll_rma_malloc<T>(block_size), where element i is
+    // data[i / block_size][i % block_size]. tmp is an array of the same
+    // shape used as the buffer of merges. data and tmp are the tables
+    // returned in the calling process, and the sort is not stable.
+    template <class T, class Compare>
+    void parallel_sort(T **data, T **tmp, long block_size, long n,
+                       Compare comp);
+
+    template <class T>
+    void parallel_sort(T **data, T **tmp, long block_size, long n);
 
     template <class F0, class F1>
     void parallel_invoke(F0&& f0, F1&& f1);
 
-    // TODO: implement
+    // all but the last function are spawned into a task group,
+    // and the last one is called by the caller
     template <class F0, class F1, class... Fs>
     void parallel_invoke(F0&& f0, F1&& f1, Fs&&... fs);
 
     template <class F0, class F1, class T, class Reduce>
     T parallel_invoke_reduce(F0&& f0, F1&& f1, T init, Reduce&& reduce);
 
-//     class task_group {
-//         class task_link;
-//     private:
-//         task_link *task_list_;
-//
-//     public:
-//         task_group();
-//         ~task_group();
-//
-//         template <class F>
-//         void run(F&& f);
-//
-//         template <class F>
-//         void run_and_wait(F&& f);
-//
-//         void wait();
-//     };
+    // parallel_invoke_reduce(f0, f1, ..., fn, init, reduce) returns
+    // reduce(...reduce(reduce(init, f0()), f1())..., fn())
+    template <class F0, class F1, class F2, class... Args,
+              class = typename std::enable_if<(sizeof...(Args) >= 2)>::type>
+    auto parallel_invoke_reduce(F0&& f0, F1&& f1, F2&& f2, Args&&... args);
+
+    // the threads run in a task group are joined by a single join counter,
+    // so spawning N threads takes one future entry instead of N.
+    // the destructor waits for the threads that are not waited yet.
+    class task_group {
+    private:
+        join_counter counter_;
+        long n_threads_;
+
+    public:
+        task_group();
+        ~task_group();
+
+        task_group(const task_group&) = delete;
+        task_group& operator=(const task_group&) = delete;
+
+        // returns false if the caller has been stolen meanwhile
+        template <class F>
+        bool run(F&& f);
+
+        template <class F>
+        void run_and_wait(F&& f);
+
+        void wait();
+
+    private:
+        template <class F>
+        static void start(join_counter counter, F f);
+    };
 
 }
 }
@@ -66,34 +201,289 @@ namespace madm {
 namespace uth {
 namespace dtbb {
 
+    inline task_group::task_group()
+        : counter_()
+        , n_threads_(0)
+    {
+    }
+
+    inline task_group::~task_group()
+    {
+        wait();
+    }
+
+    template <class F>
+    bool task_group::run(F&& f)
+    {
+        typedef typename std::decay<F>::type Fn;
+
+        madi::logger::checkpoint<madi::logger::kind::WORKER_BUSY>();
+
+        madi::worker& w = madi::current_worker();
+
+        // a counter is allocated for each group of threads between waits
+        if (n_threads_ == 0)
+            counter_ = join_counter::make(w);
+
+        n_threads_ += 1;
+
+        return w.fork(start<Fn>,
+                      std::tuple<join_counter, Fn>(counter_, std::forward<F>(f)));
+    }
+
+    template <class F>
+    void task_group::run_and_wait(F&& f)
+    {
+        f();
+        wait();
+    }
+
+    inline void task_group::wait()
+    {
+        if (n_threads_ == 0)
+            return;
+
+        counter_.wait(n_threads_, []{});
+
+        counter_ = join_counter();
+        n_threads_ = 0;
+    }
+
+    template <class F>
+    void task_group::start(join_counter counter, F f)
+    {
+        madi::logger::checkpoint<madi::logger::kind::WORKER_THREAD_FORK>();
+
+        f();
+
+        madi::logger::checkpoint<madi::logger::kind::WORKER_BUSY>();
+
+        counter.arrive();
+    }
+
+    template <class Value>
+    blocked_range<Value>::blocked_range(Value begin, Value end,
+                                        size_t grainsize)
+        : begin_(begin)
+        , end_(end)
+        , grainsize_(grainsize)
+    {
+        MADI_ASSERT(!(end < begin));
+        MADI_ASSERT(grainsize > 0);
+    }
+
+    template <class Value>
+    blocked_range<Value>::blocked_range(blocked_range& r, split)
+        : begin_(r.begin_ + (r.end_ - r.begin_) / 2)
+        , end_(r.end_)
+        , grainsize_(r.grainsize_)
+    {
+        r.end_ = begin_;
+    }
+
+    template <class RowValue, class ColValue>
+    blocked_range2d<RowValue, ColValue>::blocked_range2d(
+        RowValue row_begin, RowValue row_end, size_t row_grainsize,
+        ColValue col_begin, ColValue col_end, size_t col_grainsize)
+        : rows_(row_begin, row_end, row_grainsize)
+        , cols_(col_begin, col_end, col_grainsize)
+    {
+    }
+
+    template <class RowValue, class ColValue>
+    blocked_range2d<RowValue, ColValue>::blocked_range2d(
+        RowValue row_begin, RowValue row_end,
+        ColValue col_begin, ColValue col_end)
+        : rows_(row_begin, row_end)
+        , cols_(col_begin, col_end)
+    {
+    }
+
+    template <class RowValue, class ColValue>
+    blocked_range2d<RowValue, ColValue>::blocked_range2d(
+        blocked_range2d& r, split)
+        : rows_(r.rows_)
+        , cols_(r.cols_)
+    {
+        if (rows_.size() * cols_.grainsize() < cols_.size() * rows_.grainsize())
+            cols_ = blocked_range<ColValue>(r.cols_, split());
+        else
+            rows_ = blocked_range<RowValue>(r.rows_, split());
+    }
+
+    inline int auto_partitioner::initial_depth() const
+    {
+        // two chunks per process
+        int depth = 1;
+        for (size_t n = 1; n < get_n_procs(); n *= 2)
+            depth += 1;
+        return depth;
+    }
+
+    // the first half is run by a child, and the caller goes on to the
+    // second half. a split is spent each time, and a steal of the caller
+    // adds splits, so that the rest is divided among the thieves.
+    template <class Range, class F>
+    void parallel_for_aux(Range range, const F& f,
+                          int depth, int stolen_depth)
+    {
+        task_group tg;
+
+        while (depth > 0 && range.is_divisible()) {
+            Range second(range, split());
+            depth -= 1;
+
+            bool not_stolen = tg.run([=] {
+                parallel_for_aux(range, f, depth, stolen_depth);
+            });
+
+            range = second;
+            if (!not_stolen)
+                depth += stolen_depth;
+        }
+
+        if (!range.empty())
+            f(range);
+
+        tg.wait();
+    }
+
+    template <class Range, class F>
+    void parallel_for(const Range& range, F&& f)
+    {
+        parallel_for(range, std::forward<F>(f), auto_partitioner());
+    }
+
+    template <class Range, class F>
+    void parallel_for(const Range& range, F&& f,
+                      const auto_partitioner& partitioner)
+    {
+        parallel_for_aux(range, f, partitioner.initial_depth(),
+                         partitioner.stolen_depth());
+    }
+
+    template <class Range, class F>
+    void parallel_for(const Range& range, F&& f,
+                      const simple_partitioner& partitioner)
+    {
+        parallel_for_aux(range, f, partitioner.initial_depth(),
+                         partitioner.stolen_depth());
+    }
+
+    template <class Range, class T, class F, class Reduce>
+    T parallel_reduce_aux(Range range, const T& init, const F& f,
+                          const Reduce& reduce, int depth, int stolen_depth)
+    {
+        if (depth <= 0 || !range.is_divisible())
+            return f(range, init);
+
+        Range second(range, split());
+
+        thread<T> th;
+        bool not_stolen = th.spawn([=] {
+            return parallel_reduce_aux(range, init, f, reduce,
+                                       depth - 1, stolen_depth);
+        });
+
+        int second_depth = not_stolen ? depth - 1 : depth - 1 + stolen_depth;
+        T result1 = parallel_reduce_aux(second, init, f, reduce,
+                                        second_depth, stolen_depth);
+        T result0 = th.join();
+
+        return reduce(result0, result1);
+    }
+
+    template <class Range, class T, class F, class Reduce>
+    T parallel_reduce(const Range& range, const T& init,
+                      F&& f, Reduce reduce)
+    {
+        return parallel_reduce(range, init, std::forward<F>(f), reduce,
+                               auto_partitioner());
+    }
+
+    template <class Range, class T, class F, class Reduce>
+    T parallel_reduce(const Range& range, const T& init,
+                      F&& f, Reduce reduce,
+                      const auto_partitioner& partitioner)
+    {
+        return parallel_reduce_aux(range, init, f, reduce,
+                                   partitioner.initial_depth(),
+                                   partitioner.stolen_depth());
+    }
+
+    template <class Range, class T, class F, class Reduce>
+    T parallel_reduce(const Range& range, const T& init,
+                      F&& f, Reduce reduce,
+                      const simple_partitioner& partitioner)
+    {
+        return parallel_reduce_aux(range, init, f, reduce,
+                                   partitioner.initial_depth(),
+                                   partitioner.stolen_depth());
+    }
+
+    // an integral range with a trivially copyable body is run as a range
+    // task, which occupies one taskq entry and is split by thieves
+    template <class Index, class F>
+    constexpr bool is_range_task_loop =
+        std::is_integral<Index>::value &&
+        std::is_trivially_copyable<typename std::decay<F>::type>::value;
+
+    // otherwise, the left halves are spawned from a loop into a task group,
+    // so each level of the recursion joins with a single counter
     template <class Iterator, class F>
     void parallel_for(Iterator first, Iterator last, F&& f)
     {
-        if (last - first == 1) {
-            f(first);
-        } else {
-            auto mid = first + (last - first) / 2;
+        if (first == last)
+            return;
+
+        if constexpr (is_range_task_loop<Iterator, F>) {
+            typename std::decay<F>::type body = f;
+
+            madi::parallel_loop(first, last, 1, [body] (long lo, long hi) {
+                for (long i = lo; i < hi; i++)
+                    body((Iterator)i);
+            });
+            return;
+        }
+
+        task_group tg;
 
-            thread<void> th([=] { parallel_for(first, mid, f); });
-            parallel_for(mid, last, f);
+        while (last - first > 1) {
+            auto mid = first + (last - first) / 2;
 
-            th.join();
+            tg.run([=] { parallel_for(first, mid, f); });
+            first = mid;
         }
+
+        f(first);
+
+        tg.wait();
     }
 
     template <class Index, class F>
     void parallel_for(Index first, Index last, Index grainsize, F&& f)
     {
-        if (last - first <= grainsize) {
-            f(first, last);
-        } else {
-            auto mid = (first + last) / 2;
+        if constexpr (is_range_task_loop<Index, F>) {
+            typename std::decay<F>::type body = f;
 
-            thread<void> th([=] { parallel_for(first, mid, grainsize, f); });
-            parallel_for(mid, last, grainsize, f);
+            madi::parallel_loop(first, last, grainsize, [body] (long lo, long hi) {
+                body((Index)lo, (Index)hi);
+            });
+            return;
+        }
 
-            th.join();
+        task_group tg;
+
+        while (last - first > grainsize) {
+            auto mid = (first + last) / 2;
+
+            tg.run([=] { parallel_for(first, mid, grainsize, f); });
+            first = mid;
         }
+
+        f(first, last);
+
+        tg.wait();
     }
 
     // Iterator: integer is OK
@@ -119,12 +509,320 @@ namespace dtbb {
         }
     }
 
+    // the chunks of parallel_scan are [bound(i), bound(i + 1)), and the
+    // subtree of chunks [lo, hi) split at mid keeps the reduction of its
+    // left half in sums[mid], which is in the heap of the caller
+    template <class T>
+    struct scan_tree {
+        long first;
+        long last;
+        long grainsize;
+        T *sums;
+        madi::uth_pid_t pid;
+
+        long bound(long i) const
+        { return std::min(first + i * grainsize, last); }
+    };
+
+    // up-sweep: returns the reduction of chunks [lo, hi)
+    template <class T, class F, class Reduce>
+    T parallel_scan_up(const scan_tree<T>& tree, long lo, long hi,
+                       const F& f, const Reduce& reduce)
+    {
+        if (hi - lo == 1)
+            return f(tree.bound(lo), tree.bound(hi));
+
+        long mid = lo + (hi - lo) / 2;
+
+        thread<T> th;
+        th.spawn([=] {
+            return parallel_scan_up(tree, lo, mid, f, reduce);
+        });
+
+        T right = parallel_scan_up(tree, mid, hi, f, reduce);
+        T left = th.join();
+
+        madi::proc().com().put(&tree.sums[mid], &left, sizeof(T), tree.pid);
+
+        return reduce(left, right);
+    }
+
+    // down-sweep: prefix is the reduction of the chunks before lo
+    template <class T, class Scan, class Reduce>
+    void parallel_scan_down(const scan_tree<T>& tree, long lo, long hi,
+                            const T& prefix, const Scan& scan,
+                            const Reduce& reduce)
+    {
+        if (hi - lo == 1) {
+            scan(tree.bound(lo), tree.bound(hi), prefix);
+            return;
+        }
+
+        long mid = lo + (hi - lo) / 2;
+
+        alignas(T) uint8_t left[sizeof(T)];
+        madi::proc().com().get(left, &tree.sums[mid], sizeof(T), tree.pid);
+
+        T right_prefix = reduce(prefix, *(const T *)left);
+
+        task_group tg;
+        tg.run([=] {
+            parallel_scan_down(tree, lo, mid, prefix, scan, reduce);
+        });
+
+        parallel_scan_down(tree, mid, hi, right_prefix, scan, reduce);
+
+        tg.wait();
+    }
+
+    template <class Index, class T, class F, class Scan, class Reduce>
+    T parallel_scan(Index first, Index last, Index grainsize,
+                    const T& identity, F&& f, Scan&& scan, Reduce reduce)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "the partial sums are copied between processes");
+
+        if (!(first < last))
+            return identity;
+
+        // enlarge grains so that the partial sums are a few per process
+        long n = last - first;
+        long max_chunks = 256 * get_n_procs();
+        long g = std::max((long)grainsize, (n + max_chunks - 1) / max_chunks);
+        long n_chunks = (n + g - 1) / g;
+
+        madi::worker& w = madi::current_worker();
+        madi::uth_comm& c = madi::proc().com();
+        madi::uth_pid_t pid = c.get_pid();
+
+        T *sums = (T *)w.alloc_rma_buffer(sizeof(T) * n_chunks);
+
+        scan_tree<T> tree = { first, last, g, sums, pid };
+
+        auto f_chunk = [f] (long lo, long hi) {
+            return f((Index)lo, (Index)hi);
+        };
+        auto scan_chunk = [scan] (long lo, long hi, const T& prefix) {
+            scan((Index)lo, (Index)hi, prefix);
+        };
+
+        T total = parallel_scan_up(tree, 0, n_chunks, f_chunk, reduce);
+        parallel_scan_down(tree, 0, n_chunks, identity, scan_chunk, reduce);
+
+        madi::current_worker().free_rma_buffer(sums, pid);
+
+        return total;
+    }
+
+    // the arrays of parallel_sort. the tables passed are valid only in
+    // the calling process, so they are copied into its heap
+    template <class T>
+    struct sort_array {
+        long block_size;
+        long cutoff;            // the size of sequential sorts and merges
+        long n_procs;
+        T **tables;             // data[0, n_procs) and tmp[0, n_procs)
+        madi::uth_pid_t pid;
+    };
+
+    // the tables fetched by a thread. buffer 0 is data and 1 is tmp.
+    // a view must not live across a spawn, after which the thread
+    // may run in another process.
+    template <class T>
+    class sort_view {
+    private:
+        sort_array<T> a_;
+        std::vector<T *> ptrs_;
+
+    public:
+        explicit sort_view(const sort_array<T>& a)
+            : a_(a)
+            , ptrs_(2 * a.n_procs)
+        {
+            madi::proc().com().get(ptrs_.data(), a.tables,
+                                   sizeof(T *) * ptrs_.size(), a.pid);
+        }
+
+        // calls f(owner, address, size) for each block of [lo, hi)
+        template <class F>
+        void for_each_block(int buf, long lo, long hi, F f) const
+        {
+            while (lo < hi) {
+                long owner = lo / a_.block_size;
+                long end = std::min(hi, (owner + 1) * a_.block_size);
+
+                T *p = ptrs_[buf * a_.n_procs + owner]
+                     + (lo - owner * a_.block_size);
+                f((madi::uth_pid_t)owner, p, end - lo);
+
+                lo = end;
+            }
+        }
+
+        void get(T *dst, int buf, long lo, long hi) const
+        {
+            for_each_block(buf, lo, hi,
+                           [&] (madi::uth_pid_t owner, T *p, long size) {
+                madi::proc().com().get(dst, p, sizeof(T) * size, owner);
+                dst += size;
+            });
+        }
+
+        void put(int buf, long lo, T *src, long size) const
+        {
+            for_each_block(buf, lo, lo + size,
+                           [&] (madi::uth_pid_t owner, T *p, long size) {
+                madi::proc().com().put(p, src, sizeof(T) * size, owner);
+                src += size;
+            });
+        }
+
+        T value(int buf, long i) const
+        {
+            alignas(T) uint8_t v[sizeof(T)];
+            get((T *)v, buf, i, i + 1);
+            return *(const T *)v;
+        }
+    };
+
+    // merges runs [a_lo, a_hi) and [b_lo, b_hi) of buffer src into
+    // buffer dst from index d_lo. the longer run is split at its middle
+    // and the other one at the lower bound of the middle element.
+    template <class T, class Compare>
+    void parallel_sort_merge(const sort_array<T>& arr, int src,
+                             long a_lo, long a_hi, long b_lo, long b_hi,
+                             int dst, long d_lo, const Compare& comp)
+    {
+        if (a_hi - a_lo < b_hi - b_lo) {
+            std::swap(a_lo, b_lo);
+            std::swap(a_hi, b_hi);
+        }
+
+        long n_a = a_hi - a_lo;
+        long n_b = b_hi - b_lo;
+
+        if (n_a + n_b <= arr.cutoff) {
+            sort_view<T> v(arr);
+
+            std::vector<T> in(n_a + n_b);
+            std::vector<T> out(n_a + n_b);
+            v.get(in.data(), src, a_lo, a_hi);
+            v.get(in.data() + n_a, src, b_lo, b_hi);
+
+            std::merge(in.begin(), in.begin() + n_a,
+                       in.begin() + n_a, in.end(), out.begin(), comp);
+
+            v.put(dst, d_lo, out.data(), n_a + n_b);
+            return;
+        }
+
+        long a_mid = a_lo + n_a / 2;
+        long b_mid;
+        {
+            sort_view<T> v(arr);
+            T pivot = v.value(src, a_mid);
+
+            long lo = b_lo;
+            long hi = b_hi;
+            while (lo < hi) {
+                long m = lo + (hi - lo) / 2;
+                if (comp(v.value(src, m), pivot))
+                    lo = m + 1;
+                else
+                    hi = m;
+            }
+            b_mid = lo;
+        }
+
+        long d_mid = d_lo + (a_mid - a_lo) + (b_mid - b_lo);
+
+        task_group tg;
+        tg.run([=] {
+            parallel_sort_merge(arr, src, a_lo, a_mid, b_lo, b_mid,
+                                dst, d_lo, comp);
+        });
+
+        parallel_sort_merge(arr, src, a_mid, a_hi, b_mid, b_hi,
+                            dst, d_mid, comp);
+
+        tg.wait();
+    }
+
+    // sorts [lo, hi) of data into buffer dst. the halves are sorted into
+    // the other buffer and then merged into dst.
+    template <class T, class Compare>
+    void parallel_sort_aux(const sort_array<T>& arr, long lo, long hi,
+                           int dst, const Compare& comp)
+    {
+        if (hi - lo <= arr.cutoff) {
+            sort_view<T> v(arr);
+
+            std::vector<T> buf(hi - lo);
+            v.get(buf.data(), 0, lo, hi);
+
+            std::sort(buf.begin(), buf.end(), comp);
+
+            v.put(dst, lo, buf.data(), hi - lo);
+            return;
+        }
+
+        long mid = lo + (hi - lo) / 2;
+
+        task_group tg;
+        tg.run([=] {
+            parallel_sort_aux(arr, lo, mid, 1 - dst, comp);
+        });
+
+        parallel_sort_aux(arr, mid, hi, 1 - dst, comp);
+
+        tg.wait();
+
+        parallel_sort_merge(arr, 1 - dst, lo, mid, mid, hi, dst, lo, comp);
+    }
+
+    template <class T, class Compare>
+    void parallel_sort(T **data, T **tmp, long block_size, long n,
+                       Compare comp)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "the elements are copied between processes");
+
+        if (n < 2)
+            return;
+
+        long n_procs = (long)get_n_procs();
+        MADI_ASSERT(n <= block_size * n_procs);
+
+        madi::worker& w = madi::current_worker();
+        madi::uth_comm& c = madi::proc().com();
+        madi::uth_pid_t pid = c.get_pid();
+
+        T **tables = (T **)w.alloc_rma_buffer(sizeof(T *) * 2 * n_procs);
+        std::copy(data, data + n_procs, tables);
+        std::copy(tmp, tmp + n_procs, tables + n_procs);
+
+        // a few sequential sorts per process at the leaves
+        long cutoff = std::max(2048L, n / (64 * n_procs));
+
+        sort_array<T> arr = { block_size, cutoff, n_procs, tables, pid };
+
+        parallel_sort_aux(arr, 0, n, 0, comp);
+
+        madi::current_worker().free_rma_buffer(tables, pid);
+    }
+
+    template <class T>
+    void parallel_sort(T **data, T **tmp, long block_size, long n)
+    {
+        parallel_sort(data, tmp, block_size, n, std::less<T>());
+    }
+
     template <class F0, class F1>
     void parallel_invoke(F0&& f0, F1&& f1)
     {
-        thread<void> t0(f0);
-        f1();
-        t0.join();
+        task_group tg;
+        tg.run(std::forward<F0>(f0));
+        tg.run_and_wait(std::forward<F1>(f1));
     }
 
     template <class F0, class F1, class T, class Reduce>
@@ -137,6 +835,86 @@ namespace dtbb {
         return reduce(reduce(init, r0), r1);
     }
 
+    template <class F>
+    void parallel_invoke_aux(task_group& tg, F&& f)
+    {
+        tg.run_and_wait(std::forward<F>(f));
+    }
+
+    template <class F0, class F1, class... Fs>
+    void parallel_invoke_aux(task_group& tg, F0&& f0, F1&& f1, Fs&&... fs)
+    {
+        tg.run(std::forward<F0>(f0));
+        parallel_invoke_aux(tg, std::forward<F1>(f1), std::forward<Fs>(fs)...);
+    }
+
+    template <class F0, class F1, class... Fs>
+    void parallel_invoke(F0&& f0, F1&& f1, Fs&&... fs)
+    {
+        task_group tg;
+        parallel_invoke_aux(tg, std::forward<F0>(f0), std::forward<F1>(f1),
+                            std::forward<Fs>(fs)...);
+    }
+
+    // args is (f0, ..., fn, init, reduce), and f0, ..., f(n-1) are spawned
+    template <class T, class Args, size_t... Is>
+    T parallel_invoke_reduce_aux(Args& args, std::index_sequence<Is...>)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "the results are copied between processes");
+
+        constexpr size_t n = sizeof...(Is);
+
+        auto& last = std::get<n>(args);
+        auto& reduce = std::get<n + 2>(args);
+
+        T result = std::get<n + 1>(args);
+
+        // the spawned threads are joined by a single task group.
+        // they put their results into a buffer of this process,
+        // because the caller may have migrated when they finish.
+        madi::worker& w = madi::current_worker();
+        madi::uth_comm& c = madi::proc().com();
+        madi::uth_pid_t pid = c.get_pid();
+
+        T *results = (T *)w.alloc_rma_buffer(sizeof(T) * n);
+
+        task_group tg;
+        (tg.run([=, f = std::get<Is>(args)] {
+            T r = f();
+            madi::proc().com().put(&results[Is], &r, sizeof(T), pid);
+        }), ...);
+
+        T r_last = last();
+
+        tg.wait();
+
+        alignas(T) uint8_t buf[sizeof(T) * n];
+        c.get(buf, results, sizeof(T) * n, pid);
+
+        madi::current_worker().free_rma_buffer(results, pid);
+
+        const T *rs = (const T *)buf;
+        ((result = reduce(result, rs[Is])), ...);
+
+        return reduce(result, r_last);
+    }
+
+    template <class F0, class F1, class F2, class... Args, class>
+    auto parallel_invoke_reduce(F0&& f0, F1&& f1, F2&& f2, Args&&... args)
+    {
+        constexpr size_t n_args = sizeof...(Args) + 3;
+
+        auto all_args = std::forward_as_tuple(f0, f1, f2, args...);
+
+        typedef typename std::decay<
+            typename std::tuple_element<n_args - 2, decltype(all_args)>::type
+            >::type T;
+
+        return parallel_invoke_reduce_aux<T>(
+            all_args, std::make_index_sequence<n_args - 3>());
+    }
+
 }
 }
 }
@@ -7,6 +7,9 @@
 #include "process.h"
 #include "prof.h"
 #include <madm/threadsafe.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 
 namespace madi {
 
@@ -17,6 +20,126 @@ namespace madi {
 namespace madm {
 namespace uth {
 
+    // called with a range task popped from the local taskq. the entry is
+    // returned to the queue to be split by the scheduler, but the entries
+    // below it are resumed first, and the scheduler is entered only when
+    // the queue holds nothing else.
+    static void future_resume_below_range(const madi::taskq_entry& range_entry)
+    {
+        madi::worker& w = madi::current_worker();
+        madi::uth_comm& c = madi::proc().com();
+
+        madi::taskq_entry *e = w.taskq().pop(c);
+
+        if (e == NULL || madi::is_range_entry(*e)) {
+            if (e != NULL) {
+                madi::taskq_entry below = *e;
+                w.taskq().push(c, below);
+            }
+            w.taskq().push(c, range_entry);
+
+            w.resume_main_task();
+        }
+
+        madi::taskq_entry next = *e;
+        w.taskq().push(c, range_entry);
+
+        if (next.stack_top == 0) {
+            // a task in the uni-address region is popped
+            madi::context* ctx = (madi::context*)next.frame_base;
+            MADI_RESUME_CONTEXT(ctx);
+        } else {
+            // an evacuated task is popped
+            madi::suspended_entry se;
+            se.base      = next.frame_base;
+            se.size      = next.frame_size;
+            se.pid       = next.pid;
+            se.stack_top = next.stack_top;
+
+            w.resume_remote_suspended(se);
+        }
+
+        MADI_NOT_REACHED;
+    }
+
+    // called by a dying thread whose parent has been stolen.
+    // resume a waiter in ses, or other work if there is no waiter.
+    static void future_resume_next(madi::taskq_entry *entry,
+                                   madi::suspended_entry *ses, int n_ses)
+    {
+        madi::worker& w = madi::current_worker();
+        madi::uth_comm& c = madi::proc().com();
+
+        // call an event handler when parent thread is stolen
+        madi::proc().call_parent_is_stolen();
+
+        madi::suspended_entry* next_se = NULL;
+        for (int d = 0; d < n_ses; d++) {
+            if (ses[d].stack_top != 0 && next_se == NULL) {
+                next_se = &ses[d];
+                break;
+            }
+        }
+
+        if (next_se == NULL) {
+            // no waiter is found
+            if (entry != NULL && madi::is_range_entry(*entry)) {
+                madi::taskq_entry range_entry = *entry;
+
+                madi::logger::checkpoint<madi::logger::kind::WORKER_THREAD_DIE>();
+                future_resume_below_range(range_entry);
+            } else if (entry != NULL) {
+                // an evacuated task is popped
+
+                // TODO: we assume that all of the remaining tasks in the queue are
+                // evacuated tasks and there is no remaining stack in the uni-address region.
+
+                // resume the popped evacuated task
+                madi::suspended_entry se;
+                se.base      = entry->frame_base;
+                se.size      = entry->frame_size;
+                se.pid       = entry->pid;
+                se.stack_top = entry->stack_top;
+
+                madi::logger::checkpoint<madi::logger::kind::WORKER_THREAD_DIE>();
+                w.resume_remote_suspended(se);
+            } else {
+                // move to the scheduler
+                madi::logger::checkpoint<madi::logger::kind::WORKER_THREAD_DIE>();
+                w.resume_main_task();
+            }
+        } else {
+            // some waiters are found
+
+            if (entry != NULL) {
+                // return the popped evacuated task to the queue again
+                w.taskq().push(c, *entry);
+            }
+
+            // push the waiters to the local task queue
+            for (int d = 0; d < n_ses; d++) {
+                if (ses[d].stack_top != 0 && &ses[d] != next_se) {
+                    madi::taskq_entry te;
+                    te.frame_base = ses[d].base;
+                    te.frame_size = ses[d].size;
+                    te.pid        = ses[d].pid;
+                    te.stack_top  = ses[d].stack_top;
+
+                    w.taskq().push(c, te);
+                }
+            }
+
+            w.answer_lifelines(c);
+            w.serve_steal_requests(c);
+
+            // resume the first waiter
+            madi::logger::checkpoint<madi::logger::kind::WORKER_THREAD_DIE>();
+            w.resume_remote_suspended(*next_se);
+        }
+
+        MADI_NOT_REACHED;
+    }
+
     template <class T, int NDEPS>
     inline future<T, NDEPS>::future()
         : id_(-1)
@@ -71,69 +194,54 @@ namespace uth {
 
             // just return to the parent
         } else {
-            // call an event handler when parent thread is stolen
-            madi::proc().call_parent_is_stolen();
-
-            madi::suspended_entry* next_se = NULL;
-            for (int d = 0; d < NDEPS; d++) {
-                if (ses[d].stack_top != 0 && next_se == NULL) {
-                    next_se = &ses[d];
-                    break;
-                }
-            }
+            future_resume_next(entry, ses, NDEPS);
+        }
+    }
 
-            if (next_se == NULL) {
-                // no waiter is found
-                if (entry != NULL) {
-                    // an evacuated task is popped
+    // called by a thread suspended at an unresolved join.
+    // switch to other work until the awaited thread resumes it.
+    static void future_join_unresolved(madi::uth_pid_t owner)
+    {
+        madi::worker& w = madi::current_worker();
+        madi::uth_comm& c = madi::proc().com();
 
-                    // TODO: we assume that all of the remaining tasks in the queue are
-                    // evacuated tasks and there is no remaining stack in the uni-address region.
+        madi::taskq_entry *entry = w.taskq().pop(c);
 
-                    // resume the popped evacuated task
-                    madi::suspended_entry se;
-                    se.base      = entry->frame_base;
-                    se.size      = entry->frame_size;
-                    se.pid       = entry->pid;
-                    se.stack_top = entry->stack_top;
+        madi::logger::checkpoint<madi::logger::kind::WORKER_JOIN_UNRESOLVED>();
 
-                    madi::logger::checkpoint<madi::logger::kind::WORKER_THREAD_DIE>();
-                    w.resume_remote_suspended(se);
-                } else {
-                    // move to the scheduler
-                    madi::logger::checkpoint<madi::logger::kind::WORKER_THREAD_DIE>();
-                    w.resume_main_task();
-                }
+        if (entry != NULL && madi::is_range_entry(*entry)) {
+            madi::taskq_entry range_entry = *entry;
+            future_resume_below_range(range_entry);
+        } else if (entry != NULL) {
+            if (entry->stack_top == 0) {
+                // the parent task is popped
+                madi::context* ctx = (madi::context*)entry->frame_base;
+                MADI_RESUME_CONTEXT(ctx);
             } else {
-                // some waiters are found
-
-                if (entry != NULL) {
-                    // return the popped evacuated task to the queue again
-                    w.taskq().push(c, *entry);
-                }
-
-                // push the waiters to the local task queue
-                for (int d = 0; d < NDEPS; d++) {
-                    if (ses[d].stack_top != 0 && &ses[d] != next_se) {
-                        madi::taskq_entry te;
-                        te.frame_base = ses[d].base;
-                        te.frame_size = ses[d].size;
-                        te.pid        = ses[d].pid;
-                        te.stack_top  = ses[d].stack_top;
-
-                        w.taskq().push(c, te);
-                    }
-                }
-
-                // resume the first waiter
-                madi::logger::checkpoint<madi::logger::kind::WORKER_THREAD_DIE>();
-                w.resume_remote_suspended(*next_se);
+                // an evacuated task is popped
+                madi::suspended_entry se;
+                se.base      = entry->frame_base;
+                se.size      = entry->frame_size;
+                se.pid       = entry->pid;
+                se.stack_top = entry->stack_top;
+
+                w.resume_remote_suspended(se);
             }
+        } else {
+            // the awaited thread has been created on the owner of
+            // the future, where the rest of its subtree is likely
+            w.leapfrog(owner);
+
+            // move to the scheduler
+            w.resume_main_task();
         }
+
+        MADI_NOT_REACHED;
     }
 
     template <class T, int NDEPS>
-    static void future_join_suspended(madi::saved_context *sctx, future<T, NDEPS> f, int dep_id)
+    static void future_join_suspended(madi::saved_context *sctx, future<T, NDEPS> f, int dep_id,
+                                      madi::uth_pid_t owner, T *value)
     {
         madi::worker& w = madi::current_worker();
         madi::uth_comm& c = madi::proc().com();
@@ -144,34 +252,13 @@ namespace uth {
         se.base       = (uint8_t *)sctx;
         se.size       = offsetof(madi::saved_context, partial_stack) + sctx->stack_size;
         se.stack_top  = sctx->stack_top;
+        se.value_ptr  = (uint8_t *)value;
 
         if (w.fpool().sync_suspended(f, se, dep_id)) {
             // return to the suspended thread again
             w.resume(sctx);
         } else {
-            madi::taskq_entry *entry = w.taskq().pop(c);
-
-            madi::logger::checkpoint<madi::logger::kind::WORKER_JOIN_UNRESOLVED>();
-
-            if (entry != NULL) {
-                if (entry->stack_top == 0) {
-                    // the parent task is popped
-                    madi::context* ctx = (madi::context*)entry->frame_base;
-                    MADI_RESUME_CONTEXT(ctx);
-                } else {
-                    // an evacuated task is popped
-                    madi::suspended_entry se;
-                    se.base      = entry->frame_base;
-                    se.size      = entry->frame_size;
-                    se.pid       = entry->pid;
-                    se.stack_top = entry->stack_top;
-
-                    w.resume_remote_suspended(se);
-                }
-            } else {
-                // move to the scheduler
-                w.resume_main_task();
-            }
+            future_join_unresolved(owner);
         }
 
         MADI_NOT_REACHED;
@@ -187,15 +274,20 @@ namespace uth {
 
         T value;
         if (w.is_main_task()) {
-            while (!w.fpool().sync(*this, &value, dep_id)) {
-                cb_on_block();
-                w.do_scheduler_work();
+            if (!w.fpool().sync(*this, &value, dep_id)) {
+                w.leapfrog(pid_);
+
+                do {
+                    cb_on_block();
+                    w.do_scheduler_work();
+                } while (!w.fpool().sync(*this, &value, dep_id));
             }
         } else {
             if (!w.fpool().sync(*this, &value, dep_id)) {
                 cb_on_block();
 
-                w.suspend(future_join_suspended<T, NDEPS>, *this, dep_id);
+                w.suspend(future_join_suspended<T, NDEPS>, *this, dep_id, pid_,
+                          &value);
 
                 // worker can change after suspend
                 madi::worker& w1 = madi::current_worker();
@@ -216,6 +308,193 @@ namespace uth {
         w.fpool().discard(*this, dep_id);
     }
 
+    inline join_counter::join_counter()
+        : id_(-1)
+        , pid_(madi::PID_INVALID)
+    {
+    }
+
+    inline join_counter::join_counter(int id, madi::uth_pid_t pid)
+        : id_(id)
+        , pid_(pid)
+    {
+    }
+
+    inline join_counter join_counter::make(madi::worker& w)
+    {
+        return w.fpool().get_counter();
+    }
+
+    inline void join_counter::arrive()
+    {
+        if (id_ < 0 || pid_ == madi::PID_INVALID)
+            MADI_DIE("invalid join counter");
+
+        madi::worker& w = madi::current_worker();
+        madi::uth_comm& c = madi::proc().com();
+
+        // pop the parent thread
+        madi::taskq_entry *entry = w.taskq().pop(c);
+
+        bool parent_popped = entry != NULL && entry->stack_top == 0;
+
+        madi::suspended_entry se;
+        se.stack_top = 0;
+
+        MADI_UNUSED bool resumable = w.fpool().arrive(*this, &se);
+
+        if (parent_popped) {
+            // the waiter has not reached the join point
+            MADI_ASSERT(!resumable);
+
+            madi::logger::checkpoint<madi::logger::kind::WORKER_THREAD_DIE>();
+
+            // just return to the parent
+        } else {
+            future_resume_next(entry, &se, 1);
+        }
+    }
+
+    static void join_counter_suspended(madi::saved_context *sctx,
+                                       join_counter jc, long n_threads,
+                                       madi::uth_pid_t owner)
+    {
+        madi::worker& w = madi::current_worker();
+        madi::uth_comm& c = madi::proc().com();
+
+        madi::suspended_entry se;
+        se.pid        = c.get_pid();
+        se.base       = (uint8_t *)sctx;
+        se.size       = offsetof(madi::saved_context, partial_stack) + sctx->stack_size;
+        se.stack_top  = sctx->stack_top;
+        se.value_ptr  = NULL;
+
+        if (w.fpool().sync_counter_suspended(jc, se, n_threads)) {
+            // return to the suspended thread again
+            w.resume(sctx);
+        } else {
+            future_join_unresolved(owner);
+        }
+
+        MADI_NOT_REACHED;
+    }
+
+    template <class Callback>
+    inline void join_counter::wait(long n_threads, Callback cb_on_block)
+    {
+        madi::logger::checkpoint<madi::logger::kind::WORKER_BUSY>();
+
+        madi::worker& w = madi::current_worker();
+
+        if (w.is_main_task()) {
+            if (!w.fpool().sync_counter(*this, n_threads)) {
+                w.leapfrog(pid_);
+
+                do {
+                    cb_on_block();
+                    w.do_scheduler_work();
+                } while (!w.fpool().sync_counter(*this, n_threads));
+            }
+        } else {
+            if (!w.fpool().sync_counter(*this, n_threads)) {
+                cb_on_block();
+
+                w.suspend(join_counter_suspended, *this, n_threads, pid_);
+            }
+        }
+
+        // worker can change after suspend
+        madi::current_worker().fpool().release_counter(*this);
+
+        madi::logger::checkpoint<madi::logger::kind::WORKER_JOIN_RESOLVED>();
+    }
+
+    template <class E>
+    inline rma_array<E>::rma_array()
+        : pid_(madi::PID_INVALID)
+        , data_(NULL)
+        , size_(0)
+        , n_readers_(0)
+    {
+    }
+
+    template <class E>
+    inline rma_array<E>::rma_array(size_t size, int n_readers)
+        : pid_(madi::proc().com().get_pid())
+        , data_(NULL)
+        , size_(size)
+        , n_readers_(n_readers)
+    {
+        MADI_ASSERT(n_readers > 0);
+
+        if (size == 0)
+            return;
+
+        madi::worker& w = madi::current_worker();
+
+        uint8_t *buf = w.alloc_rma_buffer(header_size() + sizeof(E) * size);
+        *(long *)buf = n_readers;
+
+        data_ = (E *)(buf + header_size());
+    }
+
+    template <class E>
+    inline rma_array<E>::rma_array(const E *src, size_t size, int n_readers)
+        : rma_array(size, n_readers)
+    {
+        if (size > 0)
+            memcpy((void *)data_, (const void *)src, sizeof(E) * size);
+    }
+
+    template <class E>
+    inline void rma_array<E>::write(size_t offset, const E *src, size_t n)
+    {
+        MADI_ASSERT(offset + n <= size_);
+
+        if (n == 0)
+            return;
+
+        // the creating thread may have moved to another process
+        madi::uth_comm& c = madi::proc().com();
+
+        if (pid_ == c.get_pid())
+            memcpy((void *)(data_ + offset), (const void *)src, sizeof(E) * n);
+        else
+            c.put(data_ + offset, (void *)src, sizeof(E) * n, pid_);
+    }
+
+    template <class E>
+    inline void rma_array<E>::pull(E *dst)
+    {
+        if (size_ == 0)
+            return;
+
+        madi::uth_comm& c = madi::proc().com();
+        madi::worker& w = madi::current_worker();
+
+        if (pid_ == c.get_pid())
+            memcpy((void *)dst, (void *)data_, sizeof(E) * size_);
+        else
+            c.get(dst, data_, sizeof(E) * size_, pid_);
+
+        uint8_t *buf = (uint8_t *)data_ - header_size();
+
+        // the last reader frees the elements
+        if (n_readers_ > 1 &&
+            c.fetch_and_add((long *)buf, -1L, pid_) != 1)
+            return;
+
+        w.free_rma_buffer(buf, pid_);
+    }
+
+    template <class E>
+    inline std::vector<E> rma_array<E>::pull()
+    {
+        std::vector<E> v(size_);
+        pull(v.data());
+        return v;
+    }
+
 }
 }
 
@@ -227,7 +506,8 @@ namespace madi {
     }
 
     inline future_pool::future_pool() :
-        ptr_(0), buf_size_(0), remote_bufs_(NULL)
+        n_return_bufs_used_(0), ptr_(0), n_segments_(0), buf_size_(0),
+        remote_bufs_(NULL), segment_tables_(NULL)
     {
     }
     inline future_pool::~future_pool()
@@ -236,18 +516,40 @@ namespace madi {
 
     inline void future_pool::initialize(uth_comm& c, size_t buf_size)
     {
-        ptr_ = 0;
-        buf_size_ = (int)buf_size;
-
-        remote_bufs_ = (uint8_t **)c.malloc_shared(buf_size);
+        uth_pid_t me = c.get_pid();
 
-        size_t max_value_size = 1 << MAX_ENTRY_BITS;
-        forward_buf_ = (uint8_t *)malloc(max_value_size);
+        ptr_ = 0;
+        n_segments_ = 1;
+        buf_size_ = std::min(buf_size, (size_t)1 << OFFSET_BITS);
+
+        // the first segments are allocated collectively, so their
+        // addresses are known to all processes without communication
+        remote_bufs_ = (uint8_t **)c.malloc_shared(segment_alloc_size(0));
+        segment_tables_ =
+            (uint8_t ***)c.malloc_shared(sizeof(uint8_t *) * MAX_SEGMENTS);
+
+        for (int seg = 0; seg < MAX_SEGMENTS; seg++)
+            segment_tables_[me][seg] = NULL;
+        segment_tables_[me][0] = remote_bufs_[me];
+        init_ring(remote_bufs_[me], 0);
+
+        segment_cache_.assign(c.get_n_procs() * MAX_SEGMENTS, NULL);
+        for (uth_pid_t pid = 0; pid < c.get_n_procs(); pid++)
+            segment_cache_[pid * MAX_SEGMENTS] = remote_bufs_[pid];
+
+        // larger values are not forwarded
+        forward_buf_ = (uint8_t *)malloc(RENDEZVOUS_SIZE);
         forward_ret_ = false;
     }
 
     inline void future_pool::finalize(uth_comm& c)
     {
+        uth_pid_t me = c.get_pid();
+
+        for (int seg = 1; seg < n_segments_; seg++)
+            c.free_shared_local(segment_tables_[me][seg]);
+
+        c.free_shared((void **)segment_tables_);
         c.free_shared((void **)remote_bufs_);
 
         for (size_t i = 0; i < MAX_ENTRY_BITS; i++) {
@@ -256,25 +558,313 @@ namespace madi {
         }
 
         ptr_ = 0;
+        n_segments_ = 0;
         buf_size_ = 0;
         remote_bufs_ = NULL;
+        segment_tables_ = NULL;
+        segment_cache_.clear();
 
         free(forward_buf_);
     }
 
+    inline size_t future_pool::segment_size(int seg)
+    {
+        return std::min(buf_size_ << seg, (size_t)1 << OFFSET_BITS);
+    }
+
+    inline size_t future_pool::ring_capacity(int seg)
+    {
+        return segment_size(seg) / RING_BYTES_PER_SLOT;
+    }
+
+    inline size_t future_pool::segment_alloc_size(int seg)
+    {
+        return segment_size(seg) + offsetof(return_ring, slots)
+            + sizeof(uint64_t) * ring_capacity(seg);
+    }
+
+    inline void future_pool::init_ring(uint8_t *segment, int seg)
+    {
+        return_ring *r = (return_ring *)(segment + segment_size(seg));
+        r->tail = 0;
+        r->head = 0;
+        memset(r->slots, 0, sizeof(uint64_t) * ring_capacity(seg));
+    }
+
+    inline void future_pool::add_segment()
+    {
+        uth_comm& c = madi::proc().com();
+        uth_pid_t me = c.get_pid();
+
+        if (n_segments_ == MAX_SEGMENTS)
+            madi::die("future pool overflow");
+
+        int seg = n_segments_;
+        size_t size = segment_size(seg);
+
+        uint8_t *p = (uint8_t *)c.malloc_shared_local(segment_alloc_size(seg));
+
+        if (p == NULL)
+            MADI_DIE("future pool overflow (failed to allocate %zu bytes; "
+                     "try a larger MADM_COMM_ALLOCATOR_INIT_SIZE)", size);
+
+        MADI_DPUTS1("grow the future pool (segment %d, %zu bytes)", seg, size);
+
+        init_ring(p, seg);
+
+        // remote processes read the address when they first access
+        // a future in this segment
+        segment_tables_[me][seg] = p;
+        segment_cache_[me * MAX_SEGMENTS + seg] = p;
+
+        n_segments_ += 1;
+        ptr_ = 0;
+    }
+
+    inline uint8_t *future_pool::entry_ptr(uth_pid_t pid, int id)
+    {
+        int seg = id >> OFFSET_BITS;
+        int offset = id & ((1 << OFFSET_BITS) - 1);
+
+        MADI_ASSERT(0 <= seg && seg < MAX_SEGMENTS);
+
+        // segments are not freed until finalization, so the addresses
+        // can be cached
+        uint8_t *&base = segment_cache_[pid * MAX_SEGMENTS + seg];
+
+        if (base == NULL) {
+            uth_comm& c = madi::proc().com();
+            c.get_buffered(&base, &segment_tables_[pid][seg],
+                           sizeof(uint8_t *), pid);
+
+            MADI_ASSERT(base != NULL);
+        }
+
+        return base + offset;
+    }
+
+    inline future_pool::return_ring *
+    future_pool::ring_ptr(uth_pid_t pid, int seg)
+    {
+        uint8_t *base = entry_ptr(pid, seg << OFFSET_BITS);
+        return (return_ring *)(base + segment_size(seg));
+    }
+
+    inline bool future_pool::is_freed(entry_header *h)
+    {
+        uint64_t *flags = (uint64_t *)(h + 1);
+
+        for (int d = 0; d < h->ndeps; d++) {
+            if (flags[d] != locally_freed_val_ &&
+                flags[d] != remotely_freed_val_) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline bool future_pool::release_id(int id, int dep_id, uint64_t freed_val)
+    {
+        uth_pid_t me = madi::proc().com().get_pid();
+
+        entry_header *h = (entry_header *)entry_ptr(me, id);
+        uint64_t *flags = (uint64_t *)(h + 1);
+
+        MADI_ASSERT(0 <= dep_id && dep_id < h->ndeps);
+
+        flags[dep_id] = freed_val;
+
+        if (is_freed(h)) {
+            id_pools_[h->size_class].push_back(id);
+            for (int d = 0; d < h->ndeps; d++) {
+                flags[d] = 0;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // a returned (id, dep) pair in a ring slot. the layout is the same
+    // for all future types because the entry header tells the rest.
+    inline uint64_t future_pool::encode_returned(int id, int dep_id)
+    {
+        return ((uint64_t)dep_id << 32 | (uint32_t)id) + 1;
+    }
+
+    inline void future_pool::decode_returned(uint64_t v, int *id, int *dep_id)
+    {
+        v -= 1;
+        *id = (int)(v & 0xffffffff);
+        *dep_id = (int)(v >> 32);
+    }
+
+    inline size_t future_pool::collect_returned_ids()
+    {
+        uth_pid_t me = madi::proc().com().get_pid();
+        size_t n_collected = 0;
+
+        for (int seg = 0; seg < n_segments_; seg++) {
+            return_ring *r = ring_ptr(me, seg);
+            size_t capacity = ring_capacity(seg);
+
+            while (r->head != *(volatile long *)&r->tail) {
+                volatile uint64_t *slot = &r->slots[r->head % capacity];
+                uint64_t v = *slot;
+
+                // the returner has not written the slot yet
+                if (v == 0)
+                    break;
+
+                *slot = 0;
+                r->head += 1;
+
+                int id, dep_id;
+                decode_returned(v, &id, &dep_id);
+
+                if (release_id(id, dep_id, remotely_freed_val_))
+                    n_collected += 1;
+            }
+        }
+
+        return n_collected;
+    }
+
     template <class T, int NDEPS>
     inline void future_pool::reset(int id)
     {
         uth_comm& c = madi::proc().com();
         uth_pid_t me = c.get_pid();
 
-        entry<T, NDEPS> *e = (entry<T, NDEPS> *)(remote_bufs_[me] + id);
+        entry_of<T, NDEPS> *e = (entry_of<T, NDEPS> *)entry_ptr(me, id);
+
+        e->header.ndeps = NDEPS;
+        e->header.size_class = index_of_size(sizeof(entry_of<T, NDEPS>));
 
         for (int d = 0; d < NDEPS; d++) {
             e->resume_flags[d] = 0;
         }
     }
 
+    template <class T, int NDEPS>
+    inline bool future_pool::pack_value(const T& value, uint64_t *bits)
+    {
+        if (NDEPS != 1 || sizeof(T) > sizeof(uint64_t) ||
+            !std::is_trivially_copyable<T>::value)
+            return false;
+
+        uint64_t v = 0;
+        memcpy(&v, &value, sizeof(T));
+
+        if (v >> (64 - FLAG_VALUE_SHIFT) != 0)
+            return false;
+
+        *bits = v << FLAG_VALUE_SHIFT | FLAG_INLINE;
+        return true;
+    }
+
+    template <class T>
+    inline void future_pool::unpack_value(uint64_t flag, T *value)
+    {
+        uint64_t v = flag >> FLAG_VALUE_SHIFT;
+        memcpy((void *)value, &v, std::min(sizeof(T), sizeof(uint64_t)));
+    }
+
+    template <class T, int NDEPS>
+    inline const void *future_pool::stored_value(T& value, rendezvous_ref *ref)
+    {
+        if (sizeof(T) <= RENDEZVOUS_SIZE)
+            return &value;
+
+        uth_comm& c = madi::proc().com();
+        worker& w = madi::current_worker();
+
+        // the buffer holds the number of consumers yet to read the value,
+        // followed by the value
+        uint8_t *buf = w.alloc_rma_buffer(sizeof(long) + sizeof(T));
+        *(long *)buf = NDEPS;
+        memcpy(buf + sizeof(long), (void *)&value, sizeof(T));
+
+        ref->buf = buf;
+        ref->pid = c.get_pid();
+        return ref;
+    }
+
+    template <class T, int NDEPS>
+    inline void future_pool::load_value(entry_of<T, NDEPS> *e, uth_pid_t pid,
+                                        T *value)
+    {
+        uth_comm& c = madi::proc().com();
+        uth_pid_t me = c.get_pid();
+
+        rendezvous_ref ref;
+        void *dst = (sizeof(T) <= RENDEZVOUS_SIZE) ? (void *)value : (void *)&ref;
+
+        if (pid == me) {
+            comm::threadsafe::rbarrier();
+            memcpy(dst, (void *)&e->value, sizeof(e->value));
+        } else {
+            c.get_buffered(dst, &e->value, sizeof(e->value), pid);
+        }
+
+        if (sizeof(T) > RENDEZVOUS_SIZE) {
+            uint8_t *data = ref.buf + sizeof(long);
+
+            if (ref.pid == me) {
+                memcpy((void *)value, data, sizeof(T));
+            } else {
+                // the value is on a stack registered for RDMA
+                c.get(value, data, sizeof(T), ref.pid);
+            }
+
+            release_rendezvous(ref, NDEPS);
+        }
+    }
+
+    // the address of the value in the saved stack of a waiter
+    template <class T>
+    inline T *future_pool::waiter_value_ptr(const suspended_entry& se)
+    {
+        MADI_UNUSED size_t stack_size =
+            se.size - offsetof(saved_context, partial_stack);
+        size_t offset = se.value_ptr - se.stack_top;
+
+        MADI_ASSERT(se.stack_top <= se.value_ptr);
+        MADI_ASSERT(offset + sizeof(T) <= stack_size);
+
+        return (T *)(se.base + offsetof(saved_context, partial_stack) + offset);
+    }
+
+    inline void future_pool::release_rendezvous(rendezvous_ref ref, int ndeps)
+    {
+        uth_comm& c = madi::proc().com();
+        worker& w = madi::current_worker();
+
+        long *n_readers = (long *)ref.buf;
+
+        // the last consumer frees the buffer
+        if (ndeps > 1 && c.fetch_and_add(n_readers, -1L, ref.pid) != 1)
+            return;
+
+        w.free_rma_buffer(ref.buf, ref.pid);
+    }
+
+    template <class T, int NDEPS>
+    inline void future_pool::release_discarded(entry_of<T, NDEPS> *e,
+                                               uth_pid_t pid)
+    {
+        if constexpr (has_value<T> && sizeof(T) > RENDEZVOUS_SIZE) {
+            uth_comm& c = madi::proc().com();
+
+            rendezvous_ref ref;
+            if (pid == c.get_pid())
+                memcpy((void *)&ref, (void *)&e->value, sizeof(ref));
+            else
+                c.get_buffered(&ref, &e->value, sizeof(ref), pid);
+
+            release_rendezvous(ref, NDEPS);
+        }
+    }
+
     template <class T, int NDEPS>
     inline madm::uth::future<T, NDEPS> future_pool::get()
     {
@@ -282,7 +872,7 @@ namespace madi {
 
         uth_pid_t me = madi::proc().com().get_pid();
 
-        size_t entry_size = sizeof(entry<T, NDEPS>);
+        size_t entry_size = sizeof(entry_of<T, NDEPS>);
         size_t idx = index_of_size(entry_size);
 
         int real_size = 1 << idx;
@@ -290,21 +880,10 @@ namespace madi {
         if (id_pools_[idx].empty()) {
             logger::begin_data bd2 = logger::begin_event<logger::kind::COLLECT_FUTURE>();
 
-            // collect freed future ids
-            for (int id : all_allocated_ids_[idx]) {
-                // TODO: it is not guaranteed that all of the allocated ids have the
-                // same type and number of dependencies.
-                entry<T, NDEPS> *e = (entry<T, NDEPS> *)(remote_bufs_[me] + id);
-
-                if (is_freed_local(e)) {
-                    id_pools_[idx].push_back(id);
-                    for (int d = 0; d < NDEPS; d++) {
-                        e->resume_flags[d] = 0;
-                    }
-                }
-            }
+            // reclaim future ids freed by other processes
+            size_t n_collected = collect_returned_ids();
 
-            logger::end_event<logger::kind::COLLECT_FUTURE>(bd2, all_allocated_ids_[idx].size());
+            logger::end_event<logger::kind::COLLECT_FUTURE>(bd2, n_collected);
         }
 
         int id;
@@ -312,13 +891,14 @@ namespace madi {
             // pop a future id from the local pool
             id = id_pools_[idx].back();
             id_pools_[idx].pop_back();
-        } else if (ptr_ + real_size < buf_size_) {
+        } else {
             // if pool is empty, allocate a future id from ptr_
-            id = ptr_;
+            while (ptr_ + real_size > (int)segment_size(n_segments_ - 1))
+                add_segment();
+
+            id = ((n_segments_ - 1) << OFFSET_BITS) | ptr_;
             ptr_ += real_size;
             all_allocated_ids_[idx].push_back(id);
-        } else {
-            madi::die("future pool overflow");
         }
 
         reset<T, NDEPS>(id);
@@ -340,26 +920,42 @@ namespace madi {
         int fid = f.id_;
         uth_pid_t pid = f.pid_;
 
-        entry<T, NDEPS> *e = (entry<T, NDEPS> *)(remote_bufs_[pid] + fid);
+        entry_of<T, NDEPS> *e = (entry_of<T, NDEPS> *)entry_ptr(pid, fid);
 
         if (parent_popped) {
             // fast path
             MADI_ASSERT(pid == me);
 
-            e->value = value;
+            if constexpr (has_value<T>) {
+                rendezvous_ref ref;
+                const void *src = stored_value<T, NDEPS>(value, &ref);
+
+                memcpy(&e->value, src, sizeof(e->value));
+            }
             for (int d = 0; d < NDEPS; d++) {
                 e->resume_flags[d] = 1;
             }
         } else {
-            if (pid == me) {
-                e->value = value;
-            } else {
-                // value is on a stack registered for RDMA
-                c.put_buffered(&e->value, &value, sizeof(value), pid);
+            rendezvous_ref ref;
+            uint64_t bits = 0;
+
+            if constexpr (has_value<T>) {
+                const void *src = stored_value<T, NDEPS>(value, &ref);
+
+                // a small value is written together with the flag of dep 0
+                if (pid == me) {
+                    memcpy(&e->value, src, sizeof(e->value));
+                } else if (!pack_value<T, NDEPS>(value, &bits)) {
+                    // value is on a stack registered for RDMA
+                    c.put_buffered(&e->value, (void *)src, sizeof(e->value), pid);
+                }
             }
 
+            bool forwarded = false;
             for (int d = 0; d < NDEPS; d++) {
-                int flag = c.fetch_and_add(&e->resume_flags[d], 1, pid);
+                uint64_t inc = (d == 0) ? bits + 1 : 1;
+                uint64_t flag = c.fetch_and_add(&e->resume_flags[d], inc, pid)
+                    & FLAG_STATE_MASK;
                 if (flag == 0) {
                     // the parent has not reached the join point
                     ses[d].stack_top = 0;
@@ -372,16 +968,31 @@ namespace madi {
                         c.get_buffered(&ses[d], &e->s_entries[d], sizeof(suspended_entry), pid);
                     }
 
-                    if (NDEPS == 1) {
-                        // TODO: reconsider for NDEPS > 1
-                        // Since this worker resumes the parent, the return value does not
+                    if constexpr (!has_value<T>) {
+                        // the waiter only needs to be resumed
+                    } else if constexpr (sizeof(T) > RENDEZVOUS_SIZE) {
+                        // the waiter pulls the value from the buffer
+                    } else if (!forwarded) {
+                        // Since this worker resumes the first waiter, the return value does not
                         // have to be returned via the future entry (forwarding is possible).
                         forward_ret_ = true;
+                        forwarded = true;
                         *((T*)forward_buf_) = value;
+                    } else {
+                        // the other waiters are pushed to the task queue, so write the
+                        // value into their saved stacks before pushing them
+                        T *dst = waiter_value_ptr<T>(ses[d]);
+                        if (ses[d].pid == me) {
+                            memcpy((void *)dst, (void *)&value, sizeof(T));
+                        } else {
+                            c.put_buffered(dst, &value, sizeof(T), ses[d].pid);
+                        }
                     }
                 } else if (flag == 2) {
                     // this future has been discarded
                     ses[d].stack_top = 0;
+                    if constexpr (has_value<T> && sizeof(T) > RENDEZVOUS_SIZE)
+                        release_rendezvous(ref, NDEPS);
                     return_future_id(f, d);
                 }
             }
@@ -390,17 +1001,6 @@ namespace madi {
         logger::end_event<logger::kind::FUTURE_POOL_FILL>(bd, pid);
     }
 
-    template <class T, int NDEPS>
-    inline bool future_pool::is_freed_local(entry<T, NDEPS> *e) {
-        for (int d = 0; d < NDEPS; d++) {
-            if (e->resume_flags[d] != locally_freed_val_ &&
-                e->resume_flags[d] != remotely_freed_val_) {
-                return false;
-            }
-        }
-        return true;
-    }
-
     template <class T, int NDEPS>
     inline void future_pool::return_future_id(madm::uth::future<T, NDEPS> f, int dep_id)
     {
@@ -409,20 +1009,29 @@ namespace madi {
         int fid = f.id_;
         uth_pid_t pid = f.pid_;
 
-        entry<T, NDEPS> *e = (entry<T, NDEPS> *)(remote_bufs_[pid] + fid);
         if (pid == me) {
-            e->resume_flags[dep_id] = locally_freed_val_;
-
-            if (is_freed_local(e)) {
-                size_t idx = index_of_size(sizeof(entry<T, NDEPS>));
-                id_pools_[idx].push_back(fid);
-                for (int d = 0; d < NDEPS; d++) {
-                    e->resume_flags[d] = 0;
-                }
-            }
+            release_id(fid, dep_id, locally_freed_val_);
         } else {
             // return fork-join descriptor to processor pid.
-            c.put_nbi(&e->resume_flags[dep_id], &remotely_freed_val_, sizeof(remotely_freed_val_), pid);
+            // the owner marks the dependency freed when it drains the ring.
+            static_assert(NDEPS <= 0xffff, "too many dependencies");
+            static_assert(sizeof(entry_of<T, NDEPS>) >= NDEPS * RING_BYTES_PER_SLOT,
+                          "the return ring may overflow");
+
+            int seg = fid >> OFFSET_BITS;
+            return_ring *r = ring_ptr(pid, seg);
+
+            long t = c.fetch_and_add(&r->tail, 1L, pid);
+
+            // the owner skips the slot until the put is completed
+            if (n_return_bufs_used_ == N_RETURN_BUFS) {
+                c.fence();
+                n_return_bufs_used_ = 0;
+            }
+            uint64_t *v = &return_bufs_[n_return_bufs_used_++];
+            *v = encode_returned(fid, dep_id);
+
+            c.put_nbi(&r->slots[t % ring_capacity(seg)], v, sizeof(*v), pid);
         }
     }
 
@@ -436,25 +1045,24 @@ namespace madi {
         int fid = f.id_;
         uth_pid_t pid = f.pid_;
 
-        entry<T, NDEPS> *e = (entry<T, NDEPS> *)(remote_bufs_[pid] + fid);
+        entry_of<T, NDEPS> *e = (entry_of<T, NDEPS> *)entry_ptr(pid, fid);
 
-        int flag;
+        uint64_t flag;
         if (pid == me) {
             flag = e->resume_flags[dep_id];
         } else {
             flag = c.get_value(&e->resume_flags[dep_id], pid);
         }
 
-        MADI_ASSERT(0 <= fid && fid < buf_size_);
-
-        if (flag > 0) {
+        if ((flag & FLAG_STATE_MASK) > 0) {
             // The target thread has already been completed
 
-            if (pid == me) {
-                comm::threadsafe::rbarrier();
-                *value = e->value;
-            } else {
-                c.get_buffered(value, &e->value, sizeof(T), pid);
+            if constexpr (has_value<T>) {
+                if (flag & FLAG_INLINE) {
+                    unpack_value(flag, value);
+                } else {
+                    load_value<T, NDEPS>(e, pid, value);
+                }
             }
 
             return_future_id(f, dep_id);
@@ -478,7 +1086,7 @@ namespace madi {
         int fid = f.id_;
         uth_pid_t pid = f.pid_;
 
-        entry<T, NDEPS> *e = (entry<T, NDEPS> *)(remote_bufs_[pid] + fid);
+        entry_of<T, NDEPS> *e = (entry_of<T, NDEPS> *)entry_ptr(pid, fid);
 
         // This write should be done before fetch_and_add so that the target
         // can see this write after fetch_and_add by the target
@@ -489,7 +1097,8 @@ namespace madi {
         }
 
         bool ret;
-        if (c.fetch_and_add(&e->resume_flags[dep_id], 1, pid) == 0) {
+        uint64_t flag = c.fetch_and_add(&e->resume_flags[dep_id], (uint64_t)1, pid);
+        if ((flag & FLAG_STATE_MASK) == 0) {
             // the target thread is still running, so let the thread resume
             // the current thread when completed
 
@@ -497,6 +1106,17 @@ namespace madi {
         } else {
             // the target thread has already been completed
 
+            // write the value into the saved stack, which is resumed next
+            if constexpr (has_value<T> && sizeof(T) <= RENDEZVOUS_SIZE) {
+                T *dst = waiter_value_ptr<T>(se);
+
+                if (flag & FLAG_INLINE) {
+                    unpack_value(flag, dst);
+                } else {
+                    load_value<T, NDEPS>(e, pid, dst);
+                }
+            }
+
             ret = true;
         }
 
@@ -508,22 +1128,21 @@ namespace madi {
     template <class T, int NDEPS>
     inline void future_pool::sync_resume(madm::uth::future<T, NDEPS> f, T *value, int dep_id)
     {
-        if (NDEPS == 1 && forward_ret_) {
-            *value = *((T*)forward_buf_);
-            forward_ret_ = false;
-        } else {
-            uth_comm& c = madi::proc().com();
-            uth_pid_t me = c.get_pid();
+        if constexpr (!has_value<T>) {
+            // a join of thread<void> is pure synchronization
+        } else if constexpr (sizeof(T) > RENDEZVOUS_SIZE) {
             int fid = f.id_;
             uth_pid_t pid = f.pid_;
 
-            entry<T, NDEPS> *e = (entry<T, NDEPS> *)(remote_bufs_[pid] + fid);
+            entry_of<T, NDEPS> *e = (entry_of<T, NDEPS> *)entry_ptr(pid, fid);
 
-            if (pid == me) {
-                *value = e->value;
-            } else {
-                c.get_buffered(value, &e->value, sizeof(T), pid);
-            }
+            load_value<T, NDEPS>(e, pid, value);
+        } else if (forward_ret_) {
+            *value = *((T*)forward_buf_);
+            forward_ret_ = false;
+        } else {
+            // the value has been written into the saved stack
+            // by fill or sync_suspended before resuming
         }
 
         return_future_id(f, dep_id);
@@ -536,15 +1155,93 @@ namespace madi {
         int fid = f.id_;
         uth_pid_t pid = f.pid_;
 
-        entry<T, NDEPS> *e = (entry<T, NDEPS> *)(remote_bufs_[pid] + fid);
+        entry_of<T, NDEPS> *e = (entry_of<T, NDEPS> *)entry_ptr(pid, fid);
 
         // resume_flag = 2 means it is discarded
-        if (c.fetch_and_add(&e->resume_flags[dep_id], 2, pid) == 1) {
+        uint64_t flag = c.fetch_and_add(&e->resume_flags[dep_id], (uint64_t)2, pid);
+        if ((flag & FLAG_STATE_MASK) == 1) {
             // the future has been completed
+            release_discarded<T, NDEPS>(e, pid);
             return_future_id(f, dep_id);
         }
     }
 
+    inline madm::uth::join_counter future_pool::get_counter()
+    {
+        madm::uth::future<void_value, 1> f = get<void_value, 1>();
+        return madm::uth::join_counter(f.id_, f.pid_);
+    }
+
+    inline bool future_pool::arrive(madm::uth::join_counter jc,
+                                    suspended_entry *se)
+    {
+        uth_comm& c = madi::proc().com();
+        uth_pid_t pid = jc.pid_;
+
+        entry<void_value, 1> *e = (entry<void_value, 1> *)entry_ptr(pid, jc.id_);
+
+        uint64_t flag = c.fetch_and_add(&e->resume_flags[0], (uint64_t)1, pid);
+        if (flag + 1 != JOIN_BIAS)
+            return false;
+
+        // the last one to arrive, and the waiter has suspended
+        if (pid == c.get_pid()) {
+            *se = e->s_entries[0];
+        } else {
+            c.get_buffered(se, &e->s_entries[0], sizeof(suspended_entry), pid);
+        }
+        return true;
+    }
+
+    inline bool future_pool::sync_counter(madm::uth::join_counter jc,
+                                          long n_threads)
+    {
+        uth_comm& c = madi::proc().com();
+        uth_pid_t pid = jc.pid_;
+
+        entry<void_value, 1> *e = (entry<void_value, 1> *)entry_ptr(pid, jc.id_);
+
+        uint64_t flag;
+        if (pid == c.get_pid()) {
+            flag = *(volatile uint64_t *)&e->resume_flags[0];
+        } else {
+            flag = c.get_value(&e->resume_flags[0], pid);
+        }
+
+        MADI_ASSERT(flag <= (uint64_t)n_threads);
+
+        return flag == (uint64_t)n_threads;
+    }
+
+    inline bool future_pool::sync_counter_suspended(madm::uth::join_counter jc,
+                                                    suspended_entry se,
+                                                    long n_threads)
+    {
+        uth_comm& c = madi::proc().com();
+        uth_pid_t pid = jc.pid_;
+
+        entry<void_value, 1> *e = (entry<void_value, 1> *)entry_ptr(pid, jc.id_);
+
+        // This write should be done before fetch_and_add so that the last
+        // thread can see this write after its fetch_and_add
+        if (pid == c.get_pid()) {
+            e->s_entries[0] = se;
+        } else {
+            c.put_buffered(&e->s_entries[0], &se, sizeof(suspended_entry), pid);
+        }
+
+        uint64_t inc = JOIN_BIAS - (uint64_t)n_threads;
+        uint64_t flag = c.fetch_and_add(&e->resume_flags[0], inc, pid);
+
+        // otherwise, the last thread resumes the waiter
+        return flag + inc == JOIN_BIAS;
+    }
+
+    inline void future_pool::release_counter(madm::uth::join_counter jc)
+    {
+        return_future_id(madm::uth::future<void_value, 1>(jc.id_, jc.pid_), 0);
+    }
+
     inline void future_pool::discard_all_futures()
     {
         uth_comm& c = madi::proc().com();
@@ -555,7 +1252,16 @@ namespace madi {
             for (int id : all_allocated_ids_[idx]) {
                 id_pools_[idx].push_back(id);
                 size_t size = 1 << idx;
-                memset(remote_bufs_[me] + id, 0, size);
+                memset(entry_ptr(me, id), 0, size);
+            }
+        }
+
+        // the returned ids are already in the pools
+        for (int seg = 0; seg < n_segments_; seg++) {
+            return_ring *r = ring_ptr(me, seg);
+            while (r->head != *(volatile long *)&r->tail) {
+                r->slots[r->head % ring_capacity(seg)] = 0;
+                r->head += 1;
             }
         }
     }
@@ -3,19 +3,32 @@
 
 #include "madi.h"
 #include "uth/uni/taskq.h"
+#include <type_traits>
+#include <vector>
 
 namespace madi {
 
     class worker;
     class future_pool;
 
+    // the value type of futures of thread<void>. a future of this type
+    // has no value in its entry, and joining it transfers no data.
+    struct void_value {};
+
 }
 
 namespace madm {
 namespace uth {
 
+    // the value is copied as bytes between processes and stacks,
+    // so a value with pointers to its own storage (e.g., std::vector)
+    // cannot be returned. a large value is passed by rendezvous, and
+    // data of variable size is returned by reference with rma_array.
     template <class T, int NDEPS>
     class future {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "the value of a future must be trivially copyable");
+
         friend class madi::future_pool;
     private:
         int id_;
@@ -41,12 +54,75 @@ namespace uth {
     private:
         future(int id, madi::uth_pid_t pid);
     };
+
+    // a single future entry joined by any number of threads. each thread
+    // arrives at the counter when it dies, and the waiter, who knows the
+    // number of threads, is resumed by the last arrival.
+    class join_counter {
+        friend class madi::future_pool;
+    private:
+        int id_;
+        madi::uth_pid_t pid_;
+
+    public:
+        join_counter();
+
+        static join_counter make(madi::worker& w);
+
+        bool valid() const { return id_ >= 0; }
+
+        // called by each thread at the end of it
+        void arrive();
+
+        template <class Callback>
+        void wait(long n_threads, Callback cb_on_block);
+
+    private:
+        join_counter(int id, madi::uth_pid_t pid);
+    };
+
+    // an array of variable size returned from a thread by reference.
+    // the elements are kept in RMA memory of the process that creates
+    // the array, and a future carries only this handle. each of the
+    // n_readers consumers pulls the elements directly into its own
+    // memory, and the last one frees them. an array that is not pulled
+    // n_readers times (e.g., by a discarded future) is never freed.
+    template <class E>
+    class rma_array {
+        static_assert(std::is_trivially_copyable<E>::value,
+                      "the elements of an rma_array must be trivially copyable");
+    private:
+        madi::uth_pid_t pid_;
+        E *data_;               // preceded by the count of readers
+        size_t size_;
+        int n_readers_;
+
+    public:
+        rma_array();
+        explicit rma_array(size_t size, int n_readers = 1);
+        rma_array(const E *src, size_t size, int n_readers = 1);
+
+        size_t size() const { return size_; }
+        madi::uth_pid_t pid() const { return pid_; }
+
+        // writes elements [offset, offset + n) from any process
+        void write(size_t offset, const E *src, size_t n);
+
+        // copies all the elements to dst, and releases this reader's share
+        void pull(E *dst);
+        std::vector<E> pull();
+
+    private:
+        static constexpr size_t header_size()
+        { return (sizeof(long) + alignof(E) - 1) / alignof(E) * alignof(E); }
+    };
 }
 }
 
 #include <madm_misc.h>
 #include <vector>
 #include <cstdint>
+#include <type_traits>
 #include "uth_comm.h"
 
 namespace madi {
@@ -55,27 +131,104 @@ namespace madi {
         uint8_t* base;
         size_t size;
         uint8_t* stack_top;
+        uint8_t* value_ptr;     // where the waiter receives the value
     };
 
     class future_pool : noncopyable {
 
+        // a future id is (segment << OFFSET_BITS | offset in the segment).
+        // the pool grows by adding a segment twice as large as the last one.
         enum constants {
             MAX_ENTRY_BITS = 16,
+            SEGMENT_BITS = 5,
+            OFFSET_BITS = 31 - SEGMENT_BITS,
+            MAX_SEGMENTS = 1 << SEGMENT_BITS,
+            RING_BYTES_PER_SLOT = 32,
+            RENDEZVOUS_SIZE = 1024,
+            N_RETURN_BUFS = 64,
+        };
+
+        // a resume flag is a 64-bit word. bits 0-1 count the arrivals of
+        // the child (1), the parent (1) and a discard (2). a small return
+        // value is added above bit 2 by the same atomic that completes the
+        // future, so that a remote join needs a single get.
+        enum flag_bits {
+            FLAG_STATE_MASK = 0x3,
+            FLAG_INLINE     = 0x4,
+            FLAG_VALUE_SHIFT = 3,
+        };
+
+        // the resume flag of a join counter counts the arrivals. the waiter
+        // adds JOIN_BIAS - n, so the flag becomes JOIN_BIAS by the op
+        // that completes the join, whether it is the waiter's or not.
+        static constexpr uint64_t JOIN_BIAS = 1UL << 32;
+
+        // an id is recycled by any future type of the same size class,
+        // so every entry records its layout for the owner to free it
+        // without knowing the type. the header is followed by the flags.
+        struct entry_header {
+            uint16_t ndeps;
+            uint16_t size_class;
+            uint32_t reserved;
         };
 
         template <class T, int NDEPS>
         struct entry {
-            int resume_flags[NDEPS]; // 0/1/2: resume flag, 417/418: freed
+            entry_header header;
+            uint64_t resume_flags[NDEPS]; // see flag_bits, 417/418: freed
             T value;
             suspended_entry s_entries[NDEPS];
         };
 
-        int locally_freed_val_  = 417;
-        int remotely_freed_val_ = 418;
+        template <int NDEPS>
+        struct entry<void_value, NDEPS> {
+            entry_header header;
+            uint64_t resume_flags[NDEPS];
+            suspended_entry s_entries[NDEPS];
+        };
+
+        template <class T>
+        static constexpr bool has_value = !std::is_same<T, void_value>::value;
+
+        // a value larger than RENDEZVOUS_SIZE is left in RMA memory of the
+        // producer, and the entry holds a reference to it. consumers pull
+        // the value directly into their stack, and the last one frees it.
+        struct rendezvous_ref {
+            uint8_t *buf;       // allocated by worker::alloc_rma_buffer
+            uth_pid_t pid;
+        };
 
-        int ptr_;
-        int buf_size_;
-        uint8_t **remote_bufs_;
+        template <class T>
+        using stored_t = typename std::conditional<
+            (sizeof(T) > RENDEZVOUS_SIZE), rendezvous_ref, T>::type;
+
+        template <class T, int NDEPS>
+        using entry_of = entry<stored_t<T>, NDEPS>;
+
+        // (id, dep) pairs freed by other processes. each segment is followed
+        // by a ring with a slot per RING_BYTES_PER_SLOT bytes of the segment.
+        // an entry takes more than that per dependency, so a ring never
+        // holds more pairs than its capacity.
+        struct return_ring {
+            long tail;          // fetch-and-added by other processes
+            long head;          // only accessed by the owner
+            uint64_t slots[1];  // see encode_returned, 0: not written yet
+        };
+
+        // the sources of the non-blocking puts to the rings of other
+        // processes. they are reused after a fence completes the puts.
+        uint64_t return_bufs_[N_RETURN_BUFS];
+        int n_return_bufs_used_;
+
+        uint64_t locally_freed_val_  = 417;
+        uint64_t remotely_freed_val_ = 418;
+
+        int ptr_;                       // offset in the last segment
+        int n_segments_;
+        size_t buf_size_;               // size of the first segment
+        uint8_t **remote_bufs_;         // the first segments of all processes
+        uint8_t ***segment_tables_;     // segment addresses of all processes
+        std::vector<uint8_t *> segment_cache_;  // [pid * MAX_SEGMENTS + seg]
 
         std::vector<int> id_pools_[MAX_ENTRY_BITS];
         std::vector<int> all_allocated_ids_[MAX_ENTRY_BITS];
@@ -111,17 +264,58 @@ namespace madi {
         template <class T, int NDEPS>
         void discard(madm::uth::future<T, NDEPS> f, int dep_id);
 
+        madm::uth::join_counter get_counter();
+
+        bool arrive(madm::uth::join_counter jc, suspended_entry *se);
+
+        bool sync_counter(madm::uth::join_counter jc, long n_threads);
+
+        bool sync_counter_suspended(madm::uth::join_counter jc,
+                                    suspended_entry se, long n_threads);
+
+        void release_counter(madm::uth::join_counter jc);
+
         void discard_all_futures();
 
     private:
+        size_t segment_size(int seg);
+        size_t ring_capacity(int seg);
+        size_t segment_alloc_size(int seg);
+        void init_ring(uint8_t *segment, int seg);
+        void add_segment();
+        uint8_t *entry_ptr(uth_pid_t pid, int id);
+        return_ring *ring_ptr(uth_pid_t pid, int seg);
+        size_t collect_returned_ids();
+        static uint64_t encode_returned(int id, int dep_id);
+        static void decode_returned(uint64_t v, int *id, int *dep_id);
+        bool is_freed(entry_header *h);
+        bool release_id(int id, int dep_id, uint64_t freed_val);
+
         template <class T, int NDEPS>
         void reset(int id);
 
         template <class T, int NDEPS>
-        void return_future_id(madm::uth::future<T, NDEPS> f, int dep_id);
+        static bool pack_value(const T& value, uint64_t *bits);
+
+        template <class T, int NDEPS>
+        const void *stored_value(T& value, rendezvous_ref *ref);
 
         template <class T, int NDEPS>
-        bool is_freed_local(entry<T, NDEPS> *e);
+        void load_value(entry_of<T, NDEPS> *e, uth_pid_t pid, T *value);
+
+        template <class T>
+        T *waiter_value_ptr(const suspended_entry& se);
+
+        void release_rendezvous(rendezvous_ref ref, int ndeps);
+
+        template <class T, int NDEPS>
+        void release_discarded(entry_of<T, NDEPS> *e, uth_pid_t pid);
+
+        template <class T>
+        static void unpack_value(uint64_t flag, T *value);
+
+        template <class T, int NDEPS>
+        void return_future_id(madm::uth::future<T, NDEPS> f, int dep_id);
     };
 
 }
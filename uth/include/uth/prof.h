@@ -45,6 +45,13 @@ namespace madi {
         size_t n_failed_steals_empty;
         size_t t_poll_at_create;
         size_t t_dist_lock;
+        size_t n_lifeline_sleeps;
+        size_t n_lifeline_wakeups;
+        size_t n_backoff_skips;
+        size_t n_hinted_steals;
+        size_t n_served_steal_requests;
+        size_t n_leapfrog_steals;
+        size_t n_range_splits;
 
         size_t max_steals_size;
         size_t steals_idx;
@@ -54,10 +61,18 @@ namespace madi {
         prof()
             : max_stack_usage(0)
             , n_success_steals(0)
+            , n_aborted_steals(0)
             , n_failed_steals_lock(0)
             , n_failed_steals_empty(0)
             , t_poll_at_create(0)
             , t_dist_lock(0)
+            , n_lifeline_sleeps(0)
+            , n_lifeline_wakeups(0)
+            , n_backoff_skips(0)
+            , n_hinted_steals(0)
+            , n_served_steal_requests(0)
+            , n_leapfrog_steals(0)
+            , n_range_splits(0)
             , max_steals_size(uth_options.steal_log ? 16 * 1024 : 1)
             , steals_idx(0)
             , steals(max_steals_size)
@@ -122,6 +137,41 @@ namespace madi {
                                    &t_dist_lock,
                                    1, 0, madi::comm::reduce_op_sum);
 
+                size_t all_lifeline_sleeps = 0;
+                madi::comm::reduce(&all_lifeline_sleeps,
+                                   &n_lifeline_sleeps,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_lifeline_wakeups = 0;
+                madi::comm::reduce(&all_lifeline_wakeups,
+                                   &n_lifeline_wakeups,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_backoff_skips = 0;
+                madi::comm::reduce(&all_backoff_skips,
+                                   &n_backoff_skips,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_hinted_steals = 0;
+                madi::comm::reduce(&all_hinted_steals,
+                                   &n_hinted_steals,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_served_steal_requests = 0;
+                madi::comm::reduce(&all_served_steal_requests,
+                                   &n_served_steal_requests,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_leapfrog_steals = 0;
+                madi::comm::reduce(&all_leapfrog_steals,
+                                   &n_leapfrog_steals,
+                                   1, 0, madi::comm::reduce_op_sum);
+
+                size_t all_range_splits = 0;
+                madi::comm::reduce(&all_range_splits,
+                                   &n_range_splits,
+                                   1, 0, madi::comm::reduce_op_sum);
+
                 size_t all_failed_steals = all_aborted_steals
                                          + all_failed_steals_lock
                                          + all_failed_steals_empty;
@@ -136,7 +186,14 @@ namespace madi {
                            "n_failed_steals_lock = %zu, "
                            "n_failed_steals_empty = %zu, "
                            "poll_at_create_per_node = %zu\n"
-                           "dist_lock_time = %zu\n",
+                           "dist_lock_time = %zu\n"
+                           "n_lifeline_sleeps = %zu, "
+                           "n_lifeline_wakeups = %zu\n"
+                           "n_backoff_skips = %zu, "
+                           "n_hinted_steals = %zu\n"
+                           "n_served_steal_requests = %zu, "
+                           "n_leapfrog_steals = %zu\n"
+                           "n_range_splits = %zu\n",
                            stack_usage,
                            all_steals, all_success_steals,
                            all_failed_steals,
@@ -144,7 +201,14 @@ namespace madi {
                            all_failed_steals_lock,
                            all_failed_steals_empty,
                            all_poll_at_create,
-                           all_dist_lock);
+                           all_dist_lock,
+                           all_lifeline_sleeps,
+                           all_lifeline_wakeups,
+                           all_backoff_skips,
+                           all_hinted_steals,
+                           all_served_steal_requests,
+                           all_leapfrog_steals,
+                           all_range_splits);
                 }
             }
 
@@ -0,0 +1,163 @@
+#ifndef MADI_RANGE_TASK_INL_H
+#define MADI_RANGE_TASK_INL_H
+
+#include "range_task.h"
+#include "future-inl.h"
+#include "uni/worker-inl.h"
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+namespace madi {
+
+    // a thread split off from a range task
+    template <class F>
+    void range_task_start(F f, long first, long last, long grainsize,
+                          madm::uth::join_counter counter)
+    {
+        logger::checkpoint<logger::kind::WORKER_THREAD_FORK>();
+
+        parallel_loop(first, last, grainsize, f);
+
+        logger::checkpoint<logger::kind::WORKER_BUSY>();
+
+        counter.arrive();
+    }
+
+    // called by the process that has split grains [lo, hi) off a range
+    // task, with the copies of the descriptor and the body
+    template <class F>
+    void range_task_spawn(const range_task& task, const uint8_t *body,
+                          long lo, long hi)
+    {
+        // the body copied by the thief may not be aligned for F
+        alignas(F) uint8_t buf[sizeof(F)];
+        memcpy(buf, body, sizeof(F));
+        const F& f = *reinterpret_cast<const F *>(buf);
+
+        long first = task.first + lo * task.grainsize;
+        long last = std::min(task.first + hi * task.grainsize, task.last);
+
+        worker& w = madi::current_worker();
+        w.fork(range_task_start<F>,
+               std::tuple<F, long, long, long, madm::uth::join_counter>(
+                   f, first, last, task.grainsize, task.counter));
+    }
+
+    // f(lo, hi) is called for each grain of [first, last).
+    // the split-off grains are joined before returning.
+    template <class F>
+    void parallel_loop(long first, long last, long grainsize, const F& f)
+    {
+        static_assert(std::is_trivially_copyable<F>::value,
+                      "the body of a range task is copied by thieves");
+
+        if (first >= last)
+            return;
+
+        // enlarge grains if the range has too many of them
+        long n = last - first;
+        long g = std::max(grainsize, (n + range_task::MAX_GRAINS - 1)
+                                     / range_task::MAX_GRAINS);
+        long n_grains = (n + g - 1) / g;
+
+        if (n_grains < 2) {
+            f(first, last);
+            return;
+        }
+
+        worker& w = madi::current_worker();
+        uth_comm& c = madi::proc().com();
+        uth_pid_t owner = c.get_pid();
+
+        size_t size = range_task::header_size() + sizeof(F);
+
+        range_task *task = (range_task *)w.alloc_rma_buffer(size);
+        task->state     = (uint64_t)n_grains * range_task::HI_ONE
+                        + range_task::QUEUED;
+        task->first     = first;
+        task->last      = last;
+        task->grainsize = g;
+        task->counter   = madm::uth::join_counter::make(w);
+        task->spawn     = range_task_spawn<F>;
+        task->body_size = sizeof(F);
+        memcpy(task->body, &f, sizeof(F));
+
+        madm::uth::join_counter counter = task->counter;
+        uint64_t *state = (uint64_t *)&task->state;
+
+        taskq_entry entry;
+        entry.pid        = owner;
+        entry.frame_base = (uint8_t *)task;
+        entry.frame_size = size;
+        entry.stack_top  = RANGE_TASK;
+
+        w.taskq().push(c, entry);
+        w.answer_lifelines(c);
+        w.serve_steal_requests(c);
+
+        long n_remaining = n_grains;
+        for (;;) {
+            // claims get smaller toward the end of the range,
+            // so that thieves can split the rest
+            long n_claimed = std::max(1L, n_remaining / 8);
+
+            uint64_t s = c.fetch_and_add(state, (uint64_t)n_claimed, owner);
+            long lo = range_task::lo(s);
+            long hi = range_task::hi(s);
+
+            if (lo >= hi)
+                break;
+
+            long end = std::min(lo + n_claimed, hi);
+            for (long i = lo; i < end; i++) {
+                long b = first + i * g;
+                f(b, std::min(b + g, last));
+            }
+
+            n_remaining = hi - end;
+
+            // push the entry again after a thief has taken it
+            // (worker can change in f). an entry split MAX_SPLITS times
+            // is not pushed, because no thief can split it any more.
+            if (!(s & range_task::QUEUED) && n_remaining >= 2 &&
+                range_task::n_splits(s) < range_task::MAX_SPLITS) {
+                worker& w1 = madi::current_worker();
+
+                c.fetch_and_add(state, range_task::QUEUED, owner);
+
+                w1.taskq().push(c, entry);
+                w1.answer_lifelines(c);
+                w1.serve_steal_requests(c);
+            }
+
+            MADI_UTH_COMM_POLL_AT_CRAETE();
+        }
+
+        worker& w2 = madi::current_worker();
+
+        // take the entry back if it is still in the local taskq
+        uint64_t release = range_task::CLOSED;
+        if (taskq_entry *e = w2.taskq().pop(c)) {
+            taskq_entry top = *e;
+
+            if (is_range_entry(top) && top.pid == owner &&
+                top.frame_base == (uint8_t *)task)
+                release -= range_task::QUEUED;
+            else
+                w2.taskq().push(c, top);
+        }
+
+        uint64_t s = c.fetch_and_add(state, release, owner);
+
+        // the descriptor is freed by the later of the owner and the taker
+        if (!(s & range_task::QUEUED) || release != range_task::CLOSED)
+            w2.free_rma_buffer(task, owner);
+
+        counter.wait(range_task::n_splits(s), []{});
+    }
+
+}
+
+#endif
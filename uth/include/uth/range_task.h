@@ -0,0 +1,68 @@
+#ifndef MADI_RANGE_TASK_H
+#define MADI_RANGE_TASK_H
+
+#include "madi.h"
+#include "future.h"
+#include "uni/taskq.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace madi {
+
+    // a loop [first, last) in a single taskq entry. the range is divided
+    // into grains of grainsize iterations, and the owner runs the grains
+    // from the lowest one, while a thief that takes the entry splits off
+    // the upper half of the remaining grains and runs it as a new thread.
+    // no stack frame is copied for a range task, and it is pushed once
+    // for any number of iterations.
+    //
+    // the descriptor is allocated by worker::alloc_rma_buffer of the owner,
+    // and the entry refers to it by
+    //   { pid = owner, frame_base = descriptor, frame_size = its size,
+    //     stack_top = RANGE_TASK }.
+    //
+    // lo, hi, and the other states are packed in state, and updated only
+    // by fetch-and-adds. the owner claims grains by adding to lo, and
+    // a thief lowers hi by subtracting from it. at most one process has
+    // taken the entry at a time (the owner pushes it again only after
+    // the taker has cleared QUEUED), so hi is updated by one thief.
+    struct range_task {
+        static constexpr int LO_BITS = 28;
+        static constexpr int HI_BITS = 26;
+        static constexpr uint64_t LO_MASK = (1UL << LO_BITS) - 1;
+        static constexpr uint64_t HI_ONE = 1UL << LO_BITS;
+        static constexpr uint64_t HI_MASK = (1UL << HI_BITS) - 1;
+        static constexpr uint64_t QUEUED = 1UL << (LO_BITS + HI_BITS);
+        static constexpr uint64_t CLOSED = QUEUED << 1;
+        static constexpr uint64_t SPLIT_ONE = CLOSED << 1;
+
+        // the maximum # of grains (lo may exceed hi by a claim)
+        static constexpr long MAX_GRAINS = 1L << (HI_BITS - 1);
+        // the maximum # of splits counted in state
+        static constexpr long MAX_SPLITS = (1L << (64 - LO_BITS - HI_BITS - 2)) - 1;
+
+        typedef void (*spawn_fn)(const range_task& task,
+                                 const uint8_t *body, long lo, long hi);
+
+        volatile uint64_t state;    // lo | hi | QUEUED | CLOSED | # of splits
+        long first;
+        long last;
+        long grainsize;
+        madm::uth::join_counter counter;    // joins the split-off threads
+        spawn_fn spawn;                     // runs grains [lo, hi) of a copy
+        size_t body_size;
+        uint8_t body[1];                    // a copy of the loop body
+
+        static long lo(uint64_t s) { return (long)(s & LO_MASK); }
+        static long hi(uint64_t s) { return (long)((s >> LO_BITS) & HI_MASK); }
+        static long n_splits(uint64_t s) { return (long)(s / SPLIT_ONE); }
+
+        static size_t header_size() { return offsetof(range_task, body); }
+    };
+
+    template <class F>
+    void parallel_loop(long first, long last, long grainsize, const F& f);
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include "future-inl.h"
 #include "uni/worker-inl.h"
 #include <tuple>
+#include <utility>
 
 namespace madm {
 namespace uth {
@@ -13,30 +14,53 @@ namespace uth {
     thread<T, NDEPS>::thread() : future_() {}
 
     template <class T, int NDEPS>
-    template <class F, class... Args>
-    thread<T, NDEPS>::thread(const F& f, Args... args)
+    template <class F, class... Args, class>
+    thread<T, NDEPS>::thread(F&& f, Args&&... args)
         : future_()
     {
-        spawn(f, args...);
+        spawn(std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template <class T, int NDEPS>
+    thread<T, NDEPS>::thread(thread&& other)
+        : future_(other.future_)
+    {
+        other.future_ = future<T, NDEPS>();
+    }
+
+    template <class T, int NDEPS>
+    thread<T, NDEPS>& thread<T, NDEPS>::operator=(thread&& other)
+    {
+        future_ = other.future_;
+        other.future_ = future<T, NDEPS>();
+        return *this;
     }
 
     template <class T, int NDEPS>
     template <class F, class... Args>
-    bool thread<T, NDEPS>::spawn(const F& f, Args... args)
+    bool thread<T, NDEPS>::spawn(F&& f, Args&&... args)
     {
-        return spawn_aux(f, std::make_tuple(args...), [](bool parent_popped){});
+        return spawn_aux(std::forward<F>(f),
+                         std::make_tuple(std::forward<Args>(args)...),
+                         [](bool parent_popped){});
     }
 
     template <class T, int NDEPS>
     template <class F, class ArgsTuple, class Callback>
-    bool thread<T, NDEPS>::spawn_aux(const F& f, ArgsTuple args, Callback cb_on_die)
+    bool thread<T, NDEPS>::spawn_aux(F&& f, ArgsTuple&& args, Callback cb_on_die)
     {
+        typedef typename std::decay<F>::type Fn;
+        typedef typename std::decay<ArgsTuple>::type Tuple;
+
         madi::logger::checkpoint<madi::logger::kind::WORKER_BUSY>();
 
         madi::worker& w = madi::current_worker();
         future_ = future<T, NDEPS>::make(w);
 
-        return w.fork(start<F, ArgsTuple, Callback>, std::make_tuple(future_, f, args, cb_on_die));
+        return w.fork(start<Fn, Tuple, Callback>,
+                      std::tuple<future<T, NDEPS>, Fn, Tuple, Callback>(
+                          future_, std::forward<F>(f),
+                          std::forward<ArgsTuple>(args), std::move(cb_on_die)));
     }
 
     template <class T, int NDEPS>
@@ -65,7 +89,7 @@ namespace uth {
     {
         madi::logger::checkpoint<madi::logger::kind::WORKER_THREAD_FORK>();
 
-        T value = std::apply(f, args);
+        T value = std::apply(f, std::move(args));
 
         madi::logger::checkpoint<madi::logger::kind::WORKER_BUSY>();
 
@@ -75,7 +99,7 @@ namespace uth {
     template <int NDEPS>
     class thread<void, NDEPS> {
     private:
-        future<long, NDEPS> future_;
+        future<madi::void_value, NDEPS> future_;
 
     public:
         // constr/destr with no thread
@@ -83,33 +107,58 @@ namespace uth {
         ~thread() = default;
 
         // constr create a thread
-        template <class F, class... Args>
-        explicit thread(const F& f, Args... args)
+        template <class F, class... Args,
+                  class = typename std::enable_if<
+                      !std::is_same<typename std::decay<F>::type,
+                                    thread>::value>::type>
+        explicit thread(F&& f, Args&&... args)
             : future_()
         {
-            spawn(f, args...);
+            spawn(std::forward<F>(f), std::forward<Args>(args)...);
         }
 
         template <class F, class... Args>
-        bool spawn(const F& f, Args... args)
+        bool spawn(F&& f, Args&&... args)
         {
-            return spawn_aux(f, std::make_tuple(args...), [](bool parent_popped){});
+            return spawn_aux(std::forward<F>(f),
+                             std::make_tuple(std::forward<Args>(args)...),
+                             [](bool parent_popped){});
         }
 
         template <class F, class ArgsTuple, class Callback>
-        bool spawn_aux(const F& f, ArgsTuple args, Callback cb_on_die)
+        bool spawn_aux(F&& f, ArgsTuple&& args, Callback cb_on_die)
         {
+            typedef typename std::decay<F>::type Fn;
+            typedef typename std::decay<ArgsTuple>::type Tuple;
+
             madi::logger::checkpoint<madi::logger::kind::WORKER_BUSY>();
 
             madi::worker& w = madi::current_worker();
-            future_ = future<long, NDEPS>::make(w);
+            future_ = future<madi::void_value, NDEPS>::make(w);
 
-            return w.fork(start<F, ArgsTuple, Callback>, std::make_tuple(future_, f, args, cb_on_die));
+            return w.fork(start<Fn, Tuple, Callback>,
+                          std::tuple<future<madi::void_value, NDEPS>, Fn, Tuple, Callback>(
+                              future_, std::forward<F>(f),
+                              std::forward<ArgsTuple>(args), std::move(cb_on_die)));
         }
 
-        // copy and move constrs
+        // move-only.
+        // a moved-from thread does not refer to the child any more
+        thread(const thread&) = delete;
         thread& operator=(const thread&) = delete;
-        thread(thread&& other);  // TODO: implement
+
+        thread(thread&& other)
+            : future_(other.future_)
+        {
+            other.future_ = future<madi::void_value, NDEPS>();
+        }
+
+        thread& operator=(thread&& other)
+        {
+            future_ = other.future_;
+            other.future_ = future<madi::void_value, NDEPS>();
+            return *this;
+        }
 
         void join(int dep_id = 0) { join_aux(dep_id, []{}); }
         template <class Callback>
@@ -118,15 +167,15 @@ namespace uth {
 
     private:
         template <class F, class ArgsTuple, class Callback>
-        static void start(future<long, NDEPS> fut, F f, ArgsTuple args, Callback cb_on_die)
+        static void start(future<madi::void_value, NDEPS> fut, F f, ArgsTuple args, Callback cb_on_die)
         {
             madi::logger::checkpoint<madi::logger::kind::WORKER_THREAD_FORK>();
 
-            std::apply(f, args);
+            std::apply(f, std::move(args));
 
             madi::logger::checkpoint<madi::logger::kind::WORKER_BUSY>();
 
-            long value = 0;
+            madi::void_value value;
             fut.set(value, cb_on_die);
         }
     };
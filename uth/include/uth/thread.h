@@ -4,6 +4,7 @@
 #include "../uth-cxx-decls.h"
 #include "future.h"
 #include "uni/context.h"
+#include <type_traits>
 
 namespace madm {
 namespace uth {
@@ -18,16 +19,27 @@ namespace uth {
         thread();
         ~thread() = default;
 
-        // constr create a thread
-        template <class F, class... Args>
-        explicit thread(const F& f, Args... args);
+        // constr create a thread.
+        // the callable and the arguments are moved into the child
+        template <class F, class... Args,
+                  class = typename std::enable_if<
+                      !std::is_same<typename std::decay<F>::type,
+                                    thread>::value>::type>
+        explicit thread(F&& f, Args&&... args);
+
+        // copy and move constrs.
+        // a moved-from thread does not refer to the child any more
+        thread(const thread&) = default;
+        thread(thread&& other);
+        thread& operator=(const thread&) = default;
+        thread& operator=(thread&& other);
 
         // returns SYNCHED flag (false if stolen)
         template <class F, class... Args>
-        bool spawn(const F& f, Args... args);
+        bool spawn(F&& f, Args&&... args);
 
         template <class F, class ArgsTuple, class Callback>
-        bool spawn_aux(const F& f, ArgsTuple args, Callback cb_on_die);
+        bool spawn_aux(F&& f, ArgsTuple&& args, Callback cb_on_die);
 
         T join(int dep_id = 0);
 
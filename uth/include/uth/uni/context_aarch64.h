@@ -156,6 +156,8 @@ struct context {
                                                                              \
         uint8_t *stack__ = (uint8_t *)(stack_ptr);                           \
         uint8_t *smaller_top__ = (top__ < stack__) ? top__ : stack__;        \
+        /* the ABI requires a 16-byte aligned stack at a call */             \
+        smaller_top__ = (uint8_t *)((uintptr_t)smaller_top__ & ~0xFUL);      \
                                                                              \
         register void* arg0_x0       asm("x0")  = (void*)(arg0);             \
         register void* arg1_x1       asm("x1")  = (void*)(arg1);             \
@@ -171,6 +171,8 @@ struct context {
         uint8_t *stack__ = (uint8_t *)(stack_ptr);                           \
         uint8_t *top__ = rsp__ - 128;                                        \
         uint8_t *smaller_top__ = (top__ < stack__) ? top__ : stack__;        \
+        /* the ABI requires a 16-byte aligned stack at a call */             \
+        smaller_top__ = (uint8_t *)((uintptr_t)smaller_top__ & ~0xFUL);      \
                                                                              \
         void* arg0__ = (void*)(arg0);                                        \
         void* arg1__ = (void*)(arg1);                                        \
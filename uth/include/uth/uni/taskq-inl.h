@@ -4,6 +4,7 @@
 #include "taskq.h"
 #include "../uth_comm.h"
 #include <madm/threadsafe.h>
+#include <algorithm>
 
 namespace madi {
 
@@ -11,6 +12,11 @@ namespace madi {
 
     inline void global_taskque::push(uth_comm& c, const taskq_entry& entry)
     {
+        if (lockfree_) {
+            push_lockfree(c, entry);
+            return;
+        }
+
         logger::begin_data bd = logger::begin_event<logger::kind::TASKQ_PUSH>();
 
         local_empty_ = false;
@@ -23,11 +29,12 @@ namespace madi {
             pid_t me = c.get_pid();
             c.lock(&lock_, me);
 
-            if (base_ == 0)
-                madi::die("task queue overflow");
-
-            size_t size = sizeof(taskq_entry) * (top_ - base_);
-            memmove(&entries_[0], &entries_[base_], size);
+            if (top_ - base_ > n_entries_ / 2) {
+                grow(c, base_, top_);
+            } else {
+                size_t size = sizeof(taskq_entry) * (top_ - base_);
+                memmove(&entries_[0], &entries_[base_], size);
+            }
 
             top_ -= base_;
             base_ = 0;
@@ -54,6 +61,9 @@ namespace madi {
             return NULL;
         }
 
+        if (lockfree_)
+            return pop_lockfree(c);
+
         logger::begin_data bd = logger::begin_event<logger::kind::TASKQ_POP>();
 
         taskq_entry *result;
@@ -97,8 +107,155 @@ namespace madi {
         return result;
     }
 
+    inline void global_taskque::wait_steals(uth_comm& c, int n_claimed)
+    {
+        // wait for the thieves that have claimed entries
+        // but not finished copying their stack frames
+        while (n_done_steals_ - n_done_offset_ != (uint64_t)n_claimed)
+            c.poll();
+    }
+
+    inline void global_taskque::reset_lockfree(uint64_t tag, int top,
+                                               int n_claimed)
+    {
+        n_done_offset_ += n_claimed;
+        n_pushes_ = top;
+        n_pops_ = 0;
+
+        comm::threadsafe::wbarrier();
+
+        // thieves can only overdraw the state while base >= top,
+        // so a plain store loses no successful claims.
+        state_ = make_state(tag, top, 0);
+        top_ = top;
+    }
+
+    inline void global_taskque::compact_lockfree(uth_comm& c)
+    {
+        int t = top_;
+
+        // hide all the entries from thieves by making base == top
+        uint64_t s;
+        do {
+            s = state_;
+        } while (!threadsafe::compare_and_swap(&state_, s,
+                                               make_state(state_tag(s) + 1,
+                                                          t, t)));
+
+        int b = std::min(state_base(s), t);
+        int n_unclaimed = t - b;
+
+        wait_steals(c, n_pushes_ - n_pops_ - n_unclaimed);
+
+        if (n_unclaimed > n_entries_ / 2) {
+            grow(c, b, t);
+        } else {
+            size_t size = sizeof(taskq_entry) * n_unclaimed;
+            memmove(&entries_[0], &entries_[b], size);
+        }
+
+        reset_lockfree(state_tag(s) + 2, n_unclaimed,
+                       n_pushes_ - n_pops_ - n_unclaimed);
+    }
+
+    inline void global_taskque::push_lockfree(uth_comm& c,
+                                              const taskq_entry& entry)
+    {
+        logger::begin_data bd = logger::begin_event<logger::kind::TASKQ_PUSH>();
+
+        local_empty_ = false;
+
+        if (top_ == n_entries_)
+            compact_lockfree(c);
+
+        int t = top_;
+
+        entries_[t] = entry;
+
+        uint64_t s = threadsafe::fetch_and_add(&state_, STATE_TOP_ONE);
+
+        if (state_base(s) > t) {
+            // failed claims of thieves have overdrawn the base,
+            // so expose the new entry by normalizing base to t.
+            // no thief can claim any entry until the normalization.
+            do {
+                s = state_;
+            } while (!threadsafe::compare_and_swap(&state_, s,
+                                                   make_state(state_tag(s),
+                                                              t + 1, t)));
+        }
+
+        top_ = t + 1;
+        n_pushes_ += 1;
+
+        MADI_DPUTS3("top = %d", top_);
+
+        logger::end_event<logger::kind::TASKQ_PUSH>(bd);
+    }
+
+    inline taskq_entry * global_taskque::pop_lockfree(uth_comm& c)
+    {
+        logger::begin_data bd = logger::begin_event<logger::kind::TASKQ_POP>();
+
+        taskq_entry *result;
+
+        int t = top_;
+
+        if (t == 0) {
+            result = NULL;
+            local_empty_ = true;
+        } else {
+            // decrement top, and increment tag to notify thieves
+            // that the entries they fetched speculatively may be stale
+            uint64_t s = threadsafe::fetch_and_add(&state_,
+                                                   STATE_TAG_ONE - STATE_TOP_ONE);
+            int b = state_base(s);
+
+            if (b < t) {
+                result = &entries_[t - 1];
+                top_ = t - 1;
+                n_pops_ += 1;
+            } else {
+                // all the entries are stolen
+                int n_claimed = n_pushes_ - n_pops_;
+
+                wait_steals(c, n_claimed);
+
+                reset_lockfree(state_tag(s) + 2, 0, n_claimed);
+
+                result = NULL;
+                local_empty_ = true;
+            }
+        }
+
+        logger::end_event<logger::kind::TASKQ_POP>(bd);
+
+        return result;
+    }
+
     inline bool global_taskque::local_steal(taskq_entry *entry)
     {
+        if (lockfree_) {
+            uint64_t s = state_;
+
+            // quick check
+            if (state_base(s) >= state_top(s))
+                return false;
+
+            s = threadsafe::fetch_and_add(&state_, (uint64_t)1);
+
+            int b = state_base(s);
+            if (b >= state_top(s))
+                return false;
+
+            *entry = entries_[b];
+
+            // the caller (owner) copies the stack frame synchronously
+            threadsafe::fetch_and_add(&n_done_steals_, (uint64_t)1);
+
+            return true;
+        }
+
         // quick check
         if (top_ - base_ <= 0)
             return false;
@@ -122,16 +279,120 @@ namespace madi {
         return result;
     }
 
-    inline bool global_taskque::empty(uth_comm& c, uth_pid_t target,
-                                      global_taskque *taskq_buf)
+    inline void global_taskque::get_indices(uth_comm& c, uth_pid_t target,
+                                            global_taskque *taskq_buf)
+    {
+        // get top_, base_, n_entries_, and entries_ at once
+        size_t size = (uint8_t *)(&entries_ + 1) - (uint8_t *)&top_;
+
+        c.get(const_cast<int *>(&taskq_buf->top_),
+              const_cast<int *>(&this->top_), size, target);
+    }
+
+    inline int global_taskque::size(uth_comm& c, uth_pid_t target,
+                                    global_taskque *taskq_buf)
     {
         logger::begin_data bd = logger::begin_event<logger::kind::TASKQ_EMPTY>();
 
-        c.get(const_cast<int*>(&taskq_buf->top_), const_cast<int*>(&this->top_), sizeof(int) * 2, target);
+        get_indices(c, target, taskq_buf);
 
         logger::end_event<logger::kind::TASKQ_EMPTY>(bd, target);
 
-        return taskq_buf->base_ >= taskq_buf->top_;
+        return taskq_buf->top_ - taskq_buf->base_;
+    }
+
+    inline int global_taskque::local_size()
+    {
+        if (lockfree_) {
+            uint64_t s = state_;
+            return std::max(0, state_top(s) - state_base(s));
+        }
+
+        return std::max(0, top_ - base_);
+    }
+
+    inline int global_taskque::observed_size(global_taskque *taskq_buf)
+    {
+        if (lockfree_) {
+            uint64_t s = taskq_buf->state_;
+            return std::max(0, state_top(s) - state_base(s));
+        }
+
+        return std::max(0, taskq_buf->top_ - taskq_buf->base_);
+    }
+
+    inline bool global_taskque::empty(uth_comm& c, uth_pid_t target,
+                                      global_taskque *taskq_buf)
+    {
+        return size(c, target, taskq_buf) <= 0;
+    }
+
+    inline int global_taskque::steal_lockfree(uth_comm& c,
+                                              uth_pid_t target,
+                                              taskq_entry *entry_buf,
+                                              int max_entries,
+                                              global_taskque *taskq_buf)
+    {
+        // assume that `this' pointer is remote.
+
+        logger::begin_data bd0 = logger::begin_event<logger::kind::TASKQ_EMPTY>();
+
+        // get entries_ and state_ at once
+        size_t size = (uint8_t *)(&state_ + 1) - (uint8_t *)&entries_;
+
+        c.get((void *)&taskq_buf->entries_, (void *)&entries_, size, target);
+
+        logger::end_event<logger::kind::TASKQ_EMPTY>(bd0, target);
+
+        taskq_entry *entries = taskq_buf->entries_;
+        uint64_t s = taskq_buf->state_;
+        int b = state_base(s);
+        int t = state_top(s);
+
+        if (b >= t)
+            return 0;
+
+        logger::begin_data bd = logger::begin_event<logger::kind::TASKQ_STEAL_LOCKFREE>();
+
+        MADI_ASSERT(max_entries >= 1);
+
+        // entries in [b, b + n_claimed) have been pushed before the state
+        // is read, so they can be fetched in the same epoch as the claim.
+        int n_claimed = std::max(1, std::min((t - b) / 2, max_entries));
+        uint64_t value = n_claimed;
+        uint64_t s_old;
+
+        c.fetch_and_add_nbi(const_cast<uint64_t *>(&state_), &value, &s_old,
+                            target);
+        c.get_nbi(entry_buf, &entries[b], sizeof(*entry_buf) * n_claimed,
+                  target);
+        c.fence();
+
+        int b_old = state_base(s_old);
+        int t_old = state_top(s_old);
+
+        // a failed claim is not undone; the owner normalizes the base
+        int n = std::max(0, std::min(n_claimed, t_old - b_old));
+
+        if (n > 0 && (b_old != b || state_tag(s_old) != state_tag(s))) {
+            // the owner has popped or compacted the entries after the
+            // state was read, so the fetched entries may be stale.
+            // the claimed entries are not moved until steal_done.
+            entries = (taskq_entry *)c.get_value((uint64_t *)&entries_,
+                                                 target);
+            c.get(entry_buf, &entries[b_old], sizeof(*entry_buf) * n, target);
+        }
+
+        logger::end_event<logger::kind::TASKQ_STEAL_LOCKFREE>(bd, target);
+
+        return n;
+    }
+
+    inline void global_taskque::steal_done(uth_comm& c, uth_pid_t target,
+                                           int n_entries)
+    {
+        c.fetch_and_add(const_cast<uint64_t *>(&n_done_steals_),
+                        (uint64_t)n_entries, target);
     }
 
     inline bool global_taskque::trylock(uth_comm& c, uth_pid_t target)
@@ -146,9 +407,17 @@ namespace madi {
 
     inline bool global_taskque::steal(uth_comm& c,
                                       uth_pid_t target,
-                                      taskq_entry *entries,
                                       taskq_entry *entry,
                                       global_taskque *taskq_buf)
+    {
+        return steal_batch(c, target, entry, 1, taskq_buf) == 1;
+    }
+
+    inline int global_taskque::steal_batch(uth_comm& c,
+                                           uth_pid_t target,
+                                           taskq_entry *entry_buf,
+                                           int max_entries,
+                                           global_taskque *taskq_buf)
     {
         logger::begin_data bd = logger::begin_event<logger::kind::TASKQ_STEAL>();
 
@@ -156,31 +425,40 @@ namespace madi {
         // assume that this function is protected by
         // steal_trylock and steal_unlock.
 
-        bool result;
+        MADI_ASSERT(max_entries >= 1);
 
-        int b = c.fetch_and_add((int *)&base_, 1, target);
-        int t = c.get_value((int *)&top_, target);
+        int n = max_entries;
 
-        if (b < t) {
+        int b = c.fetch_and_add((int *)&base_, n, target);
+
+        get_indices(c, target, taskq_buf);
+
+        int t = taskq_buf->top_;
+        taskq_entry *entries = taskq_buf->entries_;
+
+        if (b + n > t) {
+            // the owner has popped some of [b, b + n), so give them back
+            int n_stolen = (b < t) ? t - b : 0;
+            c.fetch_and_add((int *)&base_, -(n - n_stolen), target);
+
+            n = n_stolen;
+        }
+
+        if (n > 0) {
             MADI_DPUTS3("RDMA_GET(%p, %p, %zu) rma_entries[%d] = %p",
-                        entry, &entries[b], sizeof(*entry),
+                        entry_buf, &entries[b], sizeof(*entry_buf) * n,
                         target, entries);
 
             MADI_CHECK(entries != NULL);
 
-            c.get(entry, &entries[b], sizeof(*entry), target);
+            c.get(entry_buf, &entries[b], sizeof(*entry_buf) * n, target);
 
             MADI_DPUTS3("RDMA_GET done");
-
-            result = true;
-        } else {
-            c.fetch_and_add((int *)&base_, -1, target);
-            result = false;
         }
 
         logger::end_event<logger::kind::TASKQ_STEAL>(bd, target);
 
-        return result;
+        return n;
     }
 
 }
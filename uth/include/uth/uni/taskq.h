@@ -20,6 +20,15 @@ namespace madi {
         uint8_t* stack_top;
     };
 
+    // stack_top of an entry of a range task (see range_task.h), which
+    // has neither a stack frame nor an evacuated context
+    static uint8_t * const RANGE_TASK = reinterpret_cast<uint8_t *>(1);
+
+    inline bool is_range_entry(const taskq_entry& entry)
+    {
+        return entry.stack_top == RANGE_TASK;
+    }
+
 #define MADI_TENTRY_PRINT(level, entry_ptr) \
     do { \
         MADI_UNUSED madi::taskq_entry *e__ = (entry_ptr); \
@@ -33,36 +42,110 @@ namespace madi {
                           e__->stack_top); \
     } while (false)
 
+    // There are two protocols for synchronizing the owner and thieves.
+    //
+    // - lock-based (default): a THE protocol on top_ and base_.
+    //   thieves take lock_ during a steal, including the stack copy.
+    //
+    // - lock-free (MADM_TASKQ_LOCKFREE=1): a tag, top, and base are packed
+    //   in state_. A thief claims entries by a remote fetch-and-add on the
+    //   base of state_, issued in the same epoch as the get of the entries,
+    //   and notifies the completion of the stack copy by incrementing
+    //   n_done_steals_. A claim that finds base >= top fails without undo,
+    //   and the owner normalizes such an overdrawn base when it pushes.
+    //   The owner updates state_ only with local atomics, and waits for
+    //   in-flight steals only when its entries are all stolen or the entry
+    //   array is compacted.
+    //   This protocol requires that the remote atomics of the comm layer
+    //   are atomic with respect to the local atomics of the CPU (e.g.,
+    //   Open MPI's osc/ucx satisfies it, but osc/pt2pt does not because
+    //   it returns the fetched value before applying the operation).
+    //
+    // The entry array is allocated from the RDMA-able local heap and
+    // doubled when it is full, so thieves read entries_ from the remote
+    // taskq (in the same get as top_ or state_) instead of assuming a
+    // fixed address. The owner replaces entries_ only while no thief
+    // can access the entries: under lock_ in the lock-based protocol,
+    // and after waiting for in-flight steals in the lock-free one.
     class global_taskque {
         MADI_NONCOPYABLE(global_taskque);
 
+        // top_, base_, n_entries_, and entries_ are read by a single get
         volatile int top_;
         volatile int base_;
 
-        int n_entries_;
-        taskq_entry *entries_;
+        volatile int n_entries_;
+        taskq_entry * volatile entries_;
+
+        // for the lock-free protocol (entries_ and state_ are read by
+        // a single get)
+        volatile uint64_t state_;
+        volatile uint64_t n_done_steals_;
+        uint64_t n_done_offset_;
+        int n_pushes_;
+        int n_pops_;
+        bool lockfree_;
 
         uth_comm::lock_t lock_;
 
         bool local_empty_;
 
+        size_t max_entries_;
+
+        static constexpr int STATE_INDEX_BITS = 24;
+        static constexpr uint64_t STATE_INDEX_MASK =
+            (1UL << STATE_INDEX_BITS) - 1;
+        static constexpr uint64_t STATE_TOP_ONE = 1UL << STATE_INDEX_BITS;
+        static constexpr uint64_t STATE_TAG_ONE = 1UL << (2 * STATE_INDEX_BITS);
+
+        static int state_base(uint64_t s)
+        { return (int)(s & STATE_INDEX_MASK); }
+        static int state_top(uint64_t s)
+        { return (int)((s >> STATE_INDEX_BITS) & STATE_INDEX_MASK); }
+        static uint64_t state_tag(uint64_t s)
+        { return s >> (2 * STATE_INDEX_BITS); }
+        static uint64_t make_state(uint64_t tag, int top, int base)
+        { return tag * STATE_TAG_ONE + (uint64_t)top * STATE_TOP_ONE + base; }
+
+        void push_lockfree(uth_comm& c, const taskq_entry& entry);
+        taskq_entry * pop_lockfree(uth_comm& c);
+        void compact_lockfree(uth_comm& c);
+        void wait_steals(uth_comm& c, int n_claimed);
+        void reset_lockfree(uint64_t tag, int top, int n_claimed);
+        void grow(uth_comm& c, int base, int top);
+        void get_indices(uth_comm& c, uth_pid_t target,
+                         global_taskque *taskq_buf);
+
     public:
         global_taskque();
         ~global_taskque();
 
-        void initialize(uth_comm& c, taskq_entry *entries, size_t n_entries);
+        void initialize(uth_comm& c, size_t n_entries, bool lockfree = false);
         void finalize(uth_comm& c);
 
         void push(uth_comm& c, const taskq_entry& entry);
         taskq_entry * pop(uth_comm& c);
 
+        int size(uth_comm& c, uth_pid_t target, global_taskque *taskq_buf);
         bool empty(uth_comm& c, uth_pid_t target, global_taskque *taskq_buf);
-        bool steal(uth_comm& c, uth_pid_t target, taskq_entry *entries,
-                   taskq_entry *entry, global_taskque *taskq_buf);
+        bool steal(uth_comm& c, uth_pid_t target, taskq_entry *entry,
+                   global_taskque *taskq_buf);
+        int steal_batch(uth_comm& c, uth_pid_t target, taskq_entry *entry_buf,
+                        int max_entries, global_taskque *taskq_buf);
         bool trylock(uth_comm& c, uth_pid_t target);
         void unlock(uth_comm& c, uth_pid_t target);
 
+        int steal_lockfree(uth_comm& c, uth_pid_t target,
+                           taskq_entry *entry_buf, int max_entries,
+                           global_taskque *taskq_buf);
+        void steal_done(uth_comm& c, uth_pid_t target, int n_entries);
+
         bool local_steal(taskq_entry *entry);
+        int local_size();
+
+        // # of entries in a remote taskq (of the same kind as this one)
+        // observed by the last size() or steal using taskq_buf
+        int observed_size(global_taskque *taskq_buf);
     };
 
     typedef global_taskque taskque;
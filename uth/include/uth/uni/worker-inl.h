@@ -206,7 +206,9 @@ namespace madi {
     {
         context& ctx = *ctx_ptr;
         F f = *(F *)f_ptr;
-        ArgsTuple arg = *(ArgsTuple *)arg_ptr;
+        // move the arguments into the child frame. the parent destroys
+        // its moved-from copy when it returns from fork.
+        ArgsTuple arg = std::move(*(ArgsTuple *)arg_ptr);
 
         MADI_CONTEXT_PRINT(3, &ctx);
         MADI_CONTEXT_ASSERT(&ctx);
@@ -241,6 +243,9 @@ namespace madi {
             MADI_ASSERT(entry.frame_size < 128 * 1024);
 
             w0.taskq_->push(c, entry);
+
+            w0.answer_lifelines(c);
+            w0.serve_steal_requests(c);
         }
 
         MADI_UTH_COMM_POLL_AT_CRAETE();
@@ -261,7 +266,7 @@ namespace madi {
         MADI_DPUTS2("start (ctx = %p)", ctx_ptr);
 
         // execute a child thread
-        std::apply(f, arg);
+        std::apply(f, std::move(arg));
 
         MADI_DPUTS2("end (ctx = %p)", ctx_ptr);
     }
@@ -353,6 +358,33 @@ namespace madi {
         logger::end_event<logger::kind::COLLECT_SUSPENDED>(bd, count);
     }
 
+    // called after pushing a task: share it with the idle processes
+    // that have registered on this process
+    inline void worker::answer_lifelines(uth_comm& c)
+    {
+        if (lifeline_local_ != NULL && lifeline_local_->pending)
+            wake_lifeline_thieves(c);
+    }
+
+    // steal from the process running the awaited thread
+    // when a join is unresolved
+    inline void worker::leapfrog(uth_pid_t target)
+    {
+        if (uth_options.leapfrog_steals <= 0 ||
+            target == madi::proc().com().get_pid())
+            return;
+
+        leapfrog_victim_ = target;
+        n_leapfrog_steals_ = uth_options.leapfrog_steals;
+    }
+
+    inline void worker::serve_steal_requests(uth_comm& c)
+    {
+        if (steal_ring_local_ != NULL &&
+            steal_ring_local_->head != steal_ring_local_->tail)
+            answer_steal_requests(c);
+    }
+
     inline saved_context* worker::alloc_suspended(size_t size)
     {
         uth_comm& c = madi::proc().com();
@@ -404,6 +436,29 @@ namespace madi {
         c.put_nbi(&sctx->header.is_freed, &freed_val_, sizeof(freed_val_), target);
     }
 
+    inline uint8_t* worker::alloc_rma_buffer(size_t size)
+    {
+        // allocated as an evacuated stack, so that the owner collects it
+        // when another process frees it
+        saved_context *sctx =
+            alloc_suspended(offsetof(saved_context, partial_stack) + size);
+
+        return sctx->partial_stack;
+    }
+
+    inline void worker::free_rma_buffer(void* p, uth_pid_t owner)
+    {
+        uth_comm& c = madi::proc().com();
+
+        saved_context *sctx = (saved_context *)
+            ((uint8_t *)p - offsetof(saved_context, partial_stack));
+
+        if (owner == c.get_pid())
+            free_suspended_local(sctx);
+        else
+            free_suspended_remote(sctx, owner);
+    }
+
     template <class F, class... Args>
     void worker_do_suspend(context *ctx_ptr, void *f_ptr, void *arg_ptr)
     {
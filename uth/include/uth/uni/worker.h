@@ -8,6 +8,7 @@
 #include "../debug.h"
 #include <deque>
 #include <tuple>
+#include <vector>
 
 #ifndef MADI_ENABLE_STEAL_PROF
 #define MADI_ENABLE_STEAL_PROF 0
@@ -20,6 +21,53 @@ namespace madi {
 
     struct steal_rep;
 
+    enum steal_result {
+        STEAL_RESULT_SUCCESS,
+        STEAL_RESULT_ABORTED,   // the victim's taskq looked empty
+        STEAL_RESULT_LOCKED,    // the victim's taskq was locked
+        STEAL_RESULT_EMPTY,     // no entry was stolen
+    };
+
+    // what a thief has observed about a victim (MADM_STEAL_BACKOFF > 0)
+    struct victim_history {
+        int depth;              // # of entries left (-1 if unknown)
+        steal_result result;    // result of the last steal
+        uint64_t time;          // when the last steal was done (ns)
+        uint64_t backoff;       // no steal until time + backoff (ns)
+    };
+
+    // per-process state of the lifeline graph, written by remote processes
+    struct lifeline_state {
+        static constexpr int MAX_LIFELINES = 64;
+
+        volatile long pending;    // set after a request below is set
+        volatile long wakeup;     // (pid of the waker + 1) or 0
+        volatile long requests[MAX_LIFELINES];  // requests[k] is set by
+                                                // process (me - 2^k) mod n
+    };
+
+    // per-process queue of steal requests (MADM_STEAL_MODE=2), to which
+    // thieves append their pids with a remote fetch-and-add and a put
+    struct steal_request_ring {
+        volatile long tail;         // # of tickets taken by thieves
+        long head;                  // # of served requests (owner only)
+        volatile long slots[1];     // (pid of a thief + 1) or 0,
+                                    // indexed by ticket mod n_procs
+    };
+
+    enum steal_grant_status {
+        STEAL_GRANT_WAITING = 0,
+        STEAL_GRANT_SUCCESS = 1,
+        STEAL_GRANT_EMPTY = 2,
+    };
+
+    // per-process mailbox to which a victim answers a steal request
+    struct steal_mailbox {
+        taskq_entry entry;          // an evacuated context
+        long depth;                 // # of entries left in the victim's taskq
+        volatile long status;       // steal_grant_status (written last)
+    };
+
     template <class F, class... Args>
     inline void worker_start(void *arg0, void *arg1, void *arg2, void *arg3);
     template <class F, class... Args>
@@ -46,9 +94,16 @@ namespace madi {
                                                     suspended_entry *se);
         friend void resume_remote_context(saved_context *sctx,
                                           std::tuple<taskq_entry *,
-                                          uth_pid_t, taskque *, logger::begin_data> *arg);
+                                          uth_pid_t, taskque *, int,
+                                          logger::begin_data> *arg);
         friend void resume_remote_context_by_messages(saved_context *sctx,
-                                                      steal_rep *rep);
+                                                      std::tuple<steal_rep *,
+                                                      uth_pid_t,
+                                                      logger::begin_data> *arg);
+        friend void handle_steal_request(int tag, int pid, void *p,
+                                         size_t size, comm::aminfo *info);
+        friend void handle_steal_reply(int tag, int pid, void *p,
+                                       size_t size, comm::aminfo *info);
 
         int freed_val_ = 1;
 
@@ -61,16 +116,47 @@ namespace madi {
 
         taskque *taskq_;
         taskque **taskq_array_;
-        taskq_entry **taskq_entries_array_;
         taskque *taskq_buf_;
         taskq_entry *taskq_entry_buf_;
 
+        // for message-based stealing (reused across steals)
+        std::vector<uint8_t> steal_result_buf_;  // reply from a victim
+
+        // a copy of the descriptor of a range task taken by this process
+        std::vector<uint8_t> range_task_buf_;
+
         future_pool fpool_;
 
         saved_context* main_sctx_;
 
         saved_context* suspended_threads_ = NULL;
 
+        // processes running on the same node (for hierarchical stealing)
+        std::vector<uth_pid_t> node_victims_;
+        int n_node_steal_failures_ = 0;
+
+        // lifeline-based quiescence (MADM_LIFELINE_STEALS > 0)
+        lifeline_state **lifeline_array_ = NULL;
+        lifeline_state *lifeline_local_ = NULL;
+        int n_lifelines_ = 0;
+        int n_lifeline_failures_ = 0;
+        bool lifeline_sleeping_ = false;
+        long lifeline_victim_ = -1;
+
+        // per-victim history for backoff and victim selection
+        std::vector<victim_history> victim_history_;
+        long hint_victim_ = -1;     // a victim recently seen with work
+        bool steal_skipped_ = false; // all the candidates were backing off
+
+        // victim-served steal requests (MADM_STEAL_MODE=2)
+        steal_request_ring **steal_ring_array_ = NULL;
+        steal_request_ring *steal_ring_local_ = NULL;
+        steal_mailbox **steal_mailbox_array_ = NULL;
+
+        // leapfrogging at unresolved joins (MADM_LEAPFROG_STEALS > 0)
+        long leapfrog_victim_ = -1;
+        int n_leapfrog_steals_ = 0;     // remaining steals from the victim
+
     public:
         worker();
         ~worker();
@@ -119,15 +205,47 @@ namespace madi {
         void free_suspended_local(saved_context* sctx);
         void free_suspended_remote(saved_context* sctx, pid_t target);
 
+        // a buffer in the RDMA-able heap of this process, which can be
+        // freed by any process that knows the owner
+        uint8_t* alloc_rma_buffer(size_t size);
+        void free_rma_buffer(void* p, uth_pid_t owner);
+
+        void answer_lifelines(uth_comm& c);
+        void reset_lifelines();
+        void serve_steal_requests(uth_comm& c);
+        void leapfrog(uth_pid_t target);
+
     private:
         static void do_resume(worker& w, const taskq_entry& entry,
                               uth_pid_t victim);
-        bool steal_with_lock(taskq_entry *entry,
+        void discover_node_victims(uth_comm& c);
+        uth_pid_t select_victim(uth_comm& c);
+        uth_pid_t select_victim_hierarchically(uth_comm& c);
+        uth_pid_t select_victim_by_policy(uth_comm& c);
+        uth_pid_t select_victim_with_history(uth_comm& c);
+        void notify_steal_result(uth_pid_t victim, steal_result result,
+                                 int depth);
+        void sleep_on_lifelines(uth_comm& c);
+        bool wake_from_lifeline();
+        void wake_lifeline_thieves(uth_comm& c);
+        void answer_steal_requests(uth_comm& c);
+        bool steal_with_lock(taskq_entry *entries,
+                             int *n_entries,
                              uth_pid_t *victim,
                              taskque **taskq);
+        bool steal_without_lock(taskq_entry *entries,
+                                int *n_entries,
+                                uth_pid_t *victim,
+                                taskque **taskq);
+        void evacuate_entry(uth_comm& c, taskq_entry& e, uth_pid_t owner);
+        void push_stolen_entries(taskq_entry *entries, int n_entries,
+                                 uth_pid_t victim);
         bool steal();
         bool steal_by_rdmas();
         bool steal_by_messages();
+        bool steal_by_queue();
+        bool run_range_task(const taskq_entry& entry);
+        bool run_local_range_task(uth_comm& c);
 
         void collect_suspended_freed_remotely();
     };
@@ -3,6 +3,7 @@
 
 #include "uth-inl.h"
 #include "thread-inl.h"
+#include "range_task-inl.h"
 #include "debug.h"
 
 #endif
@@ -25,11 +25,12 @@ namespace madi {
         uint8_t *buffer_;
 
         bool initialized_;
+        bool poll_at_create_;
 
     public:
         uth_comm() : rdma_id_(-1), coll_(NULL),
                      buffer_size_(0), buffer_(NULL),
-                     initialized_(false) {}
+                     initialized_(false), poll_at_create_(true) {}
         ~uth_comm() {}
 
         bool initialize(int& argc, char**& argv);
@@ -70,6 +71,11 @@ namespace madi {
         {
             return comm::fetch_and_add(dst, value, target);
         }
+        template <class T>
+        void fetch_and_add_nbi(T *dst, T *value, T *result, uth_pid_t target)
+        {
+            comm::fetch_and_add_nbi(dst, value, result, target);
+        }
 
         using lock_t = comm::lock_t;
 
@@ -83,6 +89,8 @@ namespace madi {
 
         void reg_put(void *dst, void *src, size_t size, uth_pid_t target);
         void reg_get(void *dst, void *src, size_t size, uth_pid_t target);
+        void reg_get_nbi(void *dst, void *src, size_t size, uth_pid_t target);
+        void fence();
 
         void barrier();
         bool barrier_try();
@@ -91,6 +99,7 @@ namespace madi {
         void broadcast(T* buf, size_t, uth_pid_t root);
 
         void poll();
+        bool poll_at_create() const { return poll_at_create_; }
 
         // active messages (experimental)
 
@@ -103,6 +112,8 @@ namespace madi {
 
         void amrequest(int tag, void *p, size_t size, int target);
         void amreply(int tag, void *p, size_t size, aminfo *info);
+        void amreply(int tag, void *p, size_t size, void *p2, size_t size2,
+                     aminfo *info);
     };
 
 #if MADI_ENABLE_POLLING
@@ -112,7 +123,9 @@ namespace madi {
 
 #define MADI_UTH_COMM_POLL_AT_CRAETE()              \
     do {                                            \
-        if (uth_options.profile) {                  \
+        if (!madi::proc().com().poll_at_create()) { \
+            /* done by a progress thread */         \
+        } else if (uth_options.profile) {           \
             long t0 = rdtsc();                      \
                                                     \
             MADI_UTH_COMM_POLL();                   \
@@ -14,6 +14,30 @@ namespace madi {
         int    profile;
         int    steal_log;
         int    aborting_steal;
+        int    steal_policy;
+        double steal_local_prob;
+        int    steal_local_retries;
+        int    steal_batch;
+        int    taskq_lockfree;
+        int    steal_mode;
+        int    lifeline_steals;
+        int    steal_backoff;
+        int    steal_backoff_max;
+        double steal_hint_prob;
+        int    leapfrog_steals;
+    };
+
+    // values of MADM_STEAL_POLICY
+    enum steal_policy {
+        STEAL_POLICY_RANDOM = 0,
+        STEAL_POLICY_HIERARCHICAL = 1,
+    };
+
+    // values of MADM_STEAL_MODE
+    enum steal_mode {
+        STEAL_MODE_RDMA = 0,
+        STEAL_MODE_MESSAGE = 1,
+        STEAL_MODE_QUEUE = 2,       // victims serve queued steal requests
     };
 
     extern uth_options uth_options;
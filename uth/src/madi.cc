@@ -1,6 +1,7 @@
 #include "madi-inl.h"
 #include "process-inl.h"
 #include "uni/worker-inl.h"
+#include "uth_options.h"
 
 namespace madi {
 
@@ -29,6 +30,20 @@ namespace madi {
         while (!c.barrier_try())
             w.do_scheduler_work();
 
+        // a process may have sent a steal request just before the
+        // barrier completes, and the victim has to keep serving it
+        // until every process leaves the steal loop above
+        if (uth_options.steal_mode == STEAL_MODE_MESSAGE)
+            c.barrier();
+        else if (uth_options.steal_mode == STEAL_MODE_QUEUE)
+            while (!c.barrier_try()) {
+                w.serve_steal_requests(c);
+                c.poll();
+            }
+
+        // start the next phase with random stealing
+        w.reset_lifelines();
+
         // update max stack usage
         g_prof->max_stack_usage = w.max_stack_usage();
 
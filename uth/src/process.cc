@@ -70,8 +70,11 @@ namespace madi {
         int init;
         MPI_Initialized(&init);
 
-        if (!init)
-            MPI_Init(&argc, &argv);
+        if (!init) {
+            int provided;
+            MPI_Init_thread(&argc, &argv, comm::required_thread_level(),
+                            &provided);
+        }
 
         uth_options_initialize();
 
@@ -0,0 +1,144 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <climits>
+#include <uth.h>
+#include <madm_comm.h>
+#include "process-inl.h"
+#include "uni/taskq-inl.h"
+
+// stress test of the lock-free protocol of the task queue.
+// process 0 pushes and pops entries with unique ids, and the other
+// processes steal them. every id must be consumed exactly once.
+
+using namespace madi;
+
+void real_main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s N\n", argv[0]);
+        madi::exit(1);
+    }
+    long n = atol(argv[1]);
+
+    uth_comm& c = madi::proc().com();
+    uth_pid_t me = c.get_pid();
+
+    // start small so that the entry array is grown during the test
+    size_t n_entries = 4;
+    int max_entries = 4;
+
+    taskque **taskq_array =
+        (taskque **)c.malloc_shared(sizeof(taskque));
+    long **done_array = (long **)c.malloc_shared(sizeof(long));
+
+    taskque *taskq = new (taskq_array[me]) taskque();
+    taskq->initialize(c, n_entries, true);
+    *done_array[me] = 0;
+
+    std::vector<long> counts(n, 0);
+
+    c.barrier();
+
+    uth_pid_t target = 0;
+
+    if (me == target) {
+        unsigned seed = 12345;
+        long i = 0;
+
+        // keep the queue short so that entries are compacted and
+        // the owner often competes with thieves for the last entry
+        for (long iter = 0; i < n; iter++) {
+            int n_pushes = 1 + rand_r(&seed) % 3;
+            for (int j = 0; j < n_pushes && i < n; j++, i++) {
+                taskq_entry entry;
+                entry.pid        = me;
+                entry.frame_base = (uint8_t *)i;
+                entry.frame_size = i + 1;
+                entry.stack_top  = (uint8_t *)(i + 2);
+
+                taskq->push(c, entry);
+            }
+
+            int n_pops = (iter % 64 == 63) ? INT_MAX : 1 + rand_r(&seed) % 3;
+            for (int j = 0; j < n_pops; j++) {
+                taskq_entry *entry = taskq->pop(c);
+                if (entry == NULL)
+                    break;
+
+                long id = (long)entry->frame_base;
+                MADI_CHECK(entry->frame_size == (size_t)id + 1);
+                MADI_CHECK(entry->stack_top == (uint8_t *)(id + 2));
+                counts[id] += 1;
+            }
+
+            c.poll();
+        }
+
+        // returns NULL after all the steals in progress are completed
+        while (taskq_entry *entry = taskq->pop(c)) {
+            long id = (long)entry->frame_base;
+            counts[id] += 1;
+        }
+
+        for (uth_pid_t pid = 0; pid < c.get_n_procs(); pid++)
+            if (pid != me)
+                c.put_value(done_array[pid], 1L, pid);
+    } else {
+        taskque *taskq_buf = new taskque();
+        std::vector<taskq_entry> entries(max_entries);
+
+        taskque *q = taskq_array[target];
+
+        while (!*(volatile long *)done_array[me]) {
+            int n_stolen = q->steal_lockfree(c, target,
+                                             entries.data(), max_entries,
+                                             taskq_buf);
+
+            for (int j = 0; j < n_stolen; j++) {
+                long id = (long)entries[j].frame_base;
+                MADI_CHECK(0 <= id && id < n);
+                MADI_CHECK(entries[j].frame_size == (size_t)id + 1);
+                MADI_CHECK(entries[j].stack_top == (uint8_t *)(id + 2));
+                counts[id] += 1;
+            }
+
+            if (n_stolen > 0)
+                q->steal_done(c, target, n_stolen);
+
+            c.poll();
+        }
+
+        delete taskq_buf;
+    }
+
+    c.barrier();
+
+    std::vector<long> total(n, 0);
+    madi::comm::reduce(total.data(), counts.data(), n, target,
+                       madi::comm::reduce_op_sum);
+
+    if (me == target) {
+        long n_stolen = n;
+        for (long i = 0; i < n; i++) {
+            if (total[i] != 1)
+                MADI_DIE("entry %ld is consumed %ld times", i, total[i]);
+        }
+        for (long i = 0; i < n; i++)
+            n_stolen -= counts[i];
+
+        printf("OK: n = %ld, stolen = %ld\n", n, n_stolen);
+    }
+
+    c.barrier();
+
+    taskq->finalize(c);
+    c.free_shared((void **)done_array);
+    c.free_shared((void **)taskq_array);
+}
+
+int main(int argc, char **argv)
+{
+    madm::uth::start(real_main, argc, argv);
+    return 0;
+}
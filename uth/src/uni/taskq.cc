@@ -1,12 +1,16 @@
 #include "taskq.h"
 #include "debug.h"
 #include "uth_comm.h"
+#include <algorithm>
 
 using namespace madi;
 
 global_taskque::global_taskque() :
     top_(0), base_(0),
-    n_entries_(0), entries_(NULL)
+    n_entries_(0), entries_(NULL),
+    state_(0), n_done_steals_(0), n_done_offset_(0),
+    n_pushes_(0), n_pops_(0), lockfree_(false),
+    max_entries_(0)
 {
 }
 
@@ -14,25 +18,73 @@ global_taskque::~global_taskque()
 {
 }
 
-void global_taskque::initialize(uth_comm& c, taskq_entry *entries,
-                                size_t n_entries)
+void global_taskque::initialize(uth_comm& c, size_t n_entries, bool lockfree)
 {
+    MADI_CHECK(n_entries >= 1);
     MADI_CHECK(n_entries <= INT_MAX);
+
+    // the upper half of the base field is left for overdrawn claims
+    size_t max_entries = lockfree ? STATE_INDEX_MASK / 2 : INT_MAX;
+
+    if (n_entries > max_entries)
+        MADI_DIE("MADM_TASKQ_CAPACITY must be at most %zu "
+                 "with the lock-free taskq", max_entries);
+
+    taskq_entry *entries =
+        (taskq_entry *)c.malloc_shared_local(sizeof(taskq_entry) * n_entries);
+
     MADI_CHECK(entries != NULL);
 
     base_ = 0;
     top_ = 0;
     n_entries_ = (int)n_entries;
     entries_ = entries;
+    max_entries_ = max_entries;
     local_empty_ = true;
 
+    state_ = 0;
+    n_done_steals_ = 0;
+    n_done_offset_ = 0;
+    n_pushes_ = 0;
+    n_pops_ = 0;
+    lockfree_ = lockfree;
+
     c.lock_init(&lock_);
 }
 
 void global_taskque::finalize(uth_comm& c)
 {
+    c.free_shared_local(entries_);
+
     top_ = 0;
     base_ = 0;
     n_entries_ = 0;
     entries_ = NULL;
 }
+
+void global_taskque::grow(uth_comm& c, int base, int top)
+{
+    // assume that no thief accesses the entries
+
+    size_t n_entries = std::min((size_t)n_entries_ * 2, max_entries_);
+
+    if (n_entries == (size_t)n_entries_)
+        madi::die("task queue overflow");
+
+    taskq_entry *entries =
+        (taskq_entry *)c.malloc_shared_local(sizeof(taskq_entry) * n_entries);
+
+    if (entries == NULL)
+        MADI_DIE("task queue overflow (failed to allocate %zu entries; "
+                 "try a larger MADM_COMM_ALLOCATOR_INIT_SIZE)", n_entries);
+
+    MADI_DPUTS1("grow the task queue (%d -> %zu entries)",
+                n_entries_, n_entries);
+
+    memcpy(entries, &entries_[base], sizeof(taskq_entry) * (top - base));
+
+    c.free_shared_local(entries_);
+
+    entries_ = entries;
+    n_entries_ = (int)n_entries;
+}
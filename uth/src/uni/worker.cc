@@ -1,9 +1,11 @@
 #include "uni/worker.h"
 #include "madi.h"
 #include "uni/taskq.h"
+#include "range_task.h"
 #include "uth_options.h"
 #include "debug.h"
 #include "madm_logger.h"
+#include "madm_global_clock.h"
 
 #include "madi-inl.h"
 #include "process-inl.h"
@@ -13,6 +15,10 @@
 #include "uni/worker-inl.h"
 
 #include <unistd.h>
+#include <mpi.h>
+#include <algorithm>
+#include <functional>
+#include <string>
 
 #ifndef MADI_NULLIFY_PARENT_STACK
 #define MADI_NULLIFY_PARENT_STACK 0
@@ -33,23 +39,38 @@ namespace madi {
 
 struct steal_req {
     steal_req *req_ptr;
-    steal_rep *result_rep;
-    bool done;
+    volatile bool done;
+    bool success;
+    bool locked;
+    int depth;
 };
 
 struct steal_rep {
     steal_req *req_ptr;
     bool success;
+    bool locked;      // failed because the taskq was locked
+    bool has_frames;  // false if the stolen context has been evacuated
+    int depth;        // # of entries left in the victim's taskq
     taskq_entry entry;
-    char frames[1];
+    uint8_t frames[1];
 };
 
 
+// release the victim's taskq after the stack frames are copied
+static void end_steal(uth_comm& c, taskque *taskq, uth_pid_t victim,
+                      int n_stolen)
+{
+    if (uth_options.taskq_lockfree)
+        taskq->steal_done(c, victim, n_stolen);
+    else
+        taskq->unlock(c, victim);
+}
+
 worker::worker() :
     wls_(NULL),
     cur_ctx_(NULL),
     is_main_task_(false),
-    taskq_(NULL), taskq_array_(NULL), taskq_entries_array_(NULL),
+    taskq_(NULL), taskq_array_(NULL),
     fpool_(),
     main_sctx_(NULL)
 {
@@ -63,7 +84,7 @@ worker::worker(const worker& sched) :
     wls_(NULL),
     cur_ctx_(NULL),
     is_main_task_(false),
-    taskq_(), taskq_array_(NULL), taskq_entries_array_(NULL),
+    taskq_(), taskq_array_(NULL),
     fpool_(),
     main_sctx_(NULL)
 {
@@ -79,39 +100,109 @@ void worker::initialize(uth_comm& c)
     pid_t me = c.get_pid();
 
     size_t n_entries = madi::uth_options.taskq_capacity;
-    size_t entries_size = sizeof(taskq_entry) * n_entries;
 
     taskque ** taskq_array =
         (taskque **)c.malloc_shared(sizeof(taskque));
 
     MADI_ASSERT(taskq_array[me] != NULL);
 
-    taskq_entry ** taskq_entries_array =
-        (taskq_entry **)c.malloc_shared(entries_size);
-
-    MADI_ASSERT(taskq_entries_array[me] != NULL);
-
     taskque *taskq_buf =
         (taskque *)c.malloc_shared_local(sizeof(taskque));
 
     MADI_ASSERT(taskq_buf != NULL);
 
     taskq_entry *taskq_entry_buf =
-        (taskq_entry *)c.malloc_shared_local(sizeof(taskq_entry));
+        (taskq_entry *)c.malloc_shared_local(sizeof(taskq_entry) *
+                                             uth_options.steal_batch);
 
     MADI_ASSERT(taskq_entry_buf != NULL);
 
     taskque *taskq = new (taskq_array[me]) taskque();
-    taskq->initialize(c, taskq_entries_array[me], n_entries);
+    taskq->initialize(c, n_entries, uth_options.taskq_lockfree);
 
     taskq_ = taskq;
     taskq_array_ = taskq_array;
-    taskq_entries_array_ = taskq_entries_array;
     taskq_buf_ = taskq_buf;
     taskq_entry_buf_ = taskq_entry_buf;
 
-    size_t future_buf_size = get_env("MADM_FUTURE_POOL_BUF_SIZE", 128 * 1024); // FIXME: does not work with 4MB
+#if !MADI_ENABLE_POLLING
+    if (uth_options.steal_mode == STEAL_MODE_MESSAGE)
+        MADI_DIE("MADM_STEAL_MODE=%d requires polling (--enable-polling)",
+                 STEAL_MODE_MESSAGE);
+#endif
+
+    // initial size of the future pool, which grows on demand
+    size_t future_buf_size = get_env("MADM_FUTURE_POOL_BUF_SIZE", 128 * 1024);
     fpool_.initialize(c, future_buf_size);
+
+    if (uth_options.steal_policy == STEAL_POLICY_HIERARCHICAL)
+        discover_node_victims(c);
+
+    if (uth_options.steal_backoff > 0) {
+        victim_history h = { -1, STEAL_RESULT_SUCCESS, 0, 0 };
+        victim_history_.assign(c.get_n_procs(), h);
+        hint_victim_ = -1;
+    }
+
+    if (uth_options.lifeline_steals > 0) {
+        lifeline_array_ =
+            (lifeline_state **)c.malloc_shared(sizeof(lifeline_state));
+        lifeline_local_ = lifeline_array_[me];
+
+        // lifelines of process p are (p + 2^k) mod n (k = 0, 1, ...),
+        // whose diameter is O(log n)
+        n_lifelines_ = 0;
+        while (n_lifelines_ < lifeline_state::MAX_LIFELINES &&
+               (1UL << n_lifelines_) < c.get_n_procs())
+            n_lifelines_ += 1;
+
+        reset_lifelines();
+    }
+
+    if (uth_options.steal_mode == STEAL_MODE_QUEUE) {
+        size_t ring_size = offsetof(steal_request_ring, slots)
+                         + sizeof(long) * c.get_n_procs();
+
+        steal_ring_array_ =
+            (steal_request_ring **)c.malloc_shared(ring_size);
+        steal_mailbox_array_ =
+            (steal_mailbox **)c.malloc_shared(sizeof(steal_mailbox));
+
+        steal_ring_local_ = steal_ring_array_[me];
+        memset((void *)steal_ring_local_, 0, ring_size);
+        memset((void *)steal_mailbox_array_[me], 0, sizeof(steal_mailbox));
+
+        // no request is appended before every ring is initialized
+        c.barrier();
+    }
+}
+
+void worker::discover_node_victims(uth_comm& c)
+{
+    uth_pid_t me = c.get_pid();
+    size_t n_procs = c.get_n_procs();
+
+    char name[MPI_MAX_PROCESSOR_NAME];
+    int len;
+    MPI_Get_processor_name(name, &len);
+
+    // processes with the same processor name are regarded as
+    // running on the same node
+    std::vector<unsigned long> ids(n_procs, 0);
+    std::vector<unsigned long> all_ids(n_procs, 0);
+    ids[me] = std::hash<std::string>()(std::string(name, len));
+
+    madi::comm::reduce(all_ids.data(), ids.data(), n_procs, 0,
+                       madi::comm::reduce_op_sum);
+    madi::comm::broadcast(all_ids.data(), n_procs, 0);
+
+    node_victims_.clear();
+    for (size_t pid = 0; pid < n_procs; pid++) {
+        if (pid != me && all_ids[pid] == all_ids[me])
+            node_victims_.push_back(pid);
+    }
+
+    n_node_steal_failures_ = 0;
 }
 
 void worker::finalize(uth_comm& c)
@@ -120,15 +211,30 @@ void worker::finalize(uth_comm& c)
     taskq_->finalize(c);
 
     c.free_shared((void **)taskq_array_);
-    c.free_shared((void **)taskq_entries_array_);
+    if (lifeline_array_ != NULL)
+        c.free_shared((void **)lifeline_array_);
+    if (steal_ring_array_ != NULL) {
+        c.free_shared((void **)steal_ring_array_);
+        c.free_shared((void **)steal_mailbox_array_);
+    }
     c.free_shared_local((void *)taskq_buf_);
     c.free_shared_local((void *)taskq_entry_buf_);
 
     taskq_ = NULL;
     taskq_array_ = NULL;
-    taskq_entries_array_ = NULL;
     taskq_buf_ = NULL;
     taskq_entry_buf_ = NULL;
+    lifeline_array_ = NULL;
+    lifeline_local_ = NULL;
+    steal_ring_array_ = NULL;
+    steal_ring_local_ = NULL;
+    steal_mailbox_array_ = NULL;
+
+    steal_result_buf_.clear();
+    steal_result_buf_.shrink_to_fit();
+
+    node_victims_.clear();
+    victim_history_.clear();
 }
 
 void worker::do_scheduler_work()
@@ -141,10 +247,237 @@ void worker::do_scheduler_work()
     // call a polling function for communication progress
     MADI_UTH_COMM_POLL();
 
+    // answer queued steal requests (no entry is left when idle)
+    serve_steal_requests(c);
+
+    // a range task pushed back by a thread that has found it at
+    // the top of the taskq is split here
+    if (taskq_->local_size() > 0 && run_local_range_task(c))
+        return;
+
+    // an idle process registered on lifelines does not steal
+    // until one of them shares work
+    if (lifeline_sleeping_ && !wake_from_lifeline())
+        return;
+
     // work stealing
     bool success = steal();
 
     // do nothing (stolen function is resumed at the steal() function)
+
+    if (lifeline_local_ != NULL) {
+        // a steal skipped by backoff is not a failure
+        if (success)
+            n_lifeline_failures_ = 0;
+        else if (!steal_skipped_ && ++n_lifeline_failures_ >= uth_options.lifeline_steals)
+            sleep_on_lifelines(c);
+    }
+}
+
+bool worker::run_local_range_task(uth_comm& c)
+{
+    taskq_entry *e = taskq_->pop(c);
+
+    if (e == NULL)
+        return false;
+
+    taskq_entry entry = *e;
+
+    if (!is_range_entry(entry)) {
+        taskq_->push(c, entry);
+        return false;
+    }
+
+    run_range_task(entry);
+    return true;
+}
+
+// a range task has been taken from a taskq. the upper half of the
+// remaining grains is split off, and run as a new thread on this process.
+// returns false if no grain is split off.
+bool worker::run_range_task(const taskq_entry& entry)
+{
+    uth_comm& c = madi::proc().com();
+    uth_pid_t owner = entry.pid;
+
+    range_task *task = (range_task *)entry.frame_base;
+    uint64_t *state = (uint64_t *)&task->state;
+
+    uint64_t s0 = c.fetch_and_add(state, 0UL, owner);
+    long lo = range_task::lo(s0);
+    long hi = range_task::hi(s0);
+    long mid = hi;
+
+    bool split = !(s0 & range_task::CLOSED) && hi - lo >= 2 &&
+                 range_task::n_splits(s0) < range_task::MAX_SPLITS;
+
+    // clear QUEUED, and lower hi to mid if splitting
+    uint64_t release = 0UL - range_task::QUEUED;
+
+    if (split) {
+        // the descriptor is read before the split,
+        // after which the owner may free it
+        size_t size = entry.frame_size;
+        if (range_task_buf_.size() < size)
+            range_task_buf_.resize(size);
+
+        c.get(range_task_buf_.data(), task, size, owner);
+
+        mid = lo + (hi - lo) / 2;
+        release += range_task::SPLIT_ONE
+                 - (uint64_t)(hi - mid) * range_task::HI_ONE;
+    }
+
+    uint64_t s = c.fetch_and_add(state, release, owner);
+
+    if (s & range_task::CLOSED) {
+        // the owner has finished the loop and left the descriptor
+        free_rma_buffer(task, owner);
+
+        return false;
+    }
+
+    if (!split)
+        return false;
+
+    g_prof->n_range_splits += 1;
+
+    MADI_DPUTSR1("range task split from %zu: [%ld, %ld) of [%ld, %ld)",
+                 owner, mid, hi, lo, hi);
+
+    // the owner may have run the grains beyond mid meanwhile,
+    // but the split is counted by the owner even if it is empty
+    range_task *copy = (range_task *)range_task_buf_.data();
+    copy->spawn(*copy, copy->body, std::max(mid, range_task::lo(s)), hi);
+
+    return true;
+}
+
+void worker::sleep_on_lifelines(uth_comm& c)
+{
+    uth_pid_t me = c.get_pid();
+    size_t n_procs = c.get_n_procs();
+
+    if (n_lifelines_ == 0)
+        return;
+
+    for (int k = 0; k < n_lifelines_; k++) {
+        uth_pid_t buddy = (me + (1UL << k)) % n_procs;
+        lifeline_state *s = lifeline_array_[buddy];
+
+        c.put_value((long *)&s->requests[k], 1L, buddy);
+        c.put_value((long *)&s->pending, 1L, buddy);
+    }
+
+    lifeline_sleeping_ = true;
+    g_prof->n_lifeline_sleeps += 1;
+
+    MADI_DPUTSR1("sleep on %d lifelines", n_lifelines_);
+}
+
+bool worker::wake_from_lifeline()
+{
+    long waker = lifeline_local_->wakeup;
+
+    if (waker == 0)
+        return false;
+
+    lifeline_local_->wakeup = 0;
+
+    // steal from the process that has woken me up first
+    lifeline_sleeping_ = false;
+    lifeline_victim_ = waker - 1;
+    n_lifeline_failures_ = 0;
+
+    MADI_DPUTSR1("woken up by %ld", waker - 1);
+
+    return true;
+}
+
+void worker::wake_lifeline_thieves(uth_comm& c)
+{
+    uth_pid_t me = c.get_pid();
+    size_t n_procs = c.get_n_procs();
+    lifeline_state *s = lifeline_local_;
+
+    // clear pending before the requests, because a thief sets
+    // its request before pending
+    s->pending = 0;
+    comm::threadsafe::rwbarrier();
+
+    for (int k = 0; k < n_lifelines_; k++) {
+        if (!s->requests[k])
+            continue;
+
+        s->requests[k] = 0;
+
+        uth_pid_t thief = (me + n_procs - (1UL << k) % n_procs) % n_procs;
+        c.put_value((long *)&lifeline_array_[thief]->wakeup,
+                    (long)me + 1, thief);
+
+        g_prof->n_lifeline_wakeups += 1;
+    }
+}
+
+void worker::answer_steal_requests(uth_comm& c)
+{
+    uth_pid_t me = c.get_pid();
+    size_t n_procs = c.get_n_procs();
+    steal_request_ring *r = steal_ring_local_;
+
+    // requests are served in the order of the tickets. a thief that has
+    // taken a ticket but not written its pid yet is served next time.
+    while (r->head != r->tail) {
+        volatile long& slot = r->slots[r->head % n_procs];
+        long v = slot;
+
+        if (v == 0)
+            break;
+
+        slot = 0;
+        r->head += 1;
+
+        uth_pid_t thief = (uth_pid_t)(v - 1);
+
+        // thieves do not access the taskq in this mode,
+        // so the owner can steal an entry without the lock
+        steal_mailbox m;
+        long status;
+        if (taskq_->local_steal(&m.entry)) {
+            // the stack frame in the uni-address region is evacuated
+            // because this process continues to use the region
+            evacuate_entry(c, m.entry, me);
+
+            status = STEAL_GRANT_SUCCESS;
+        } else {
+            status = STEAL_GRANT_EMPTY;
+        }
+
+        m.depth = taskq_->local_size();
+
+        steal_mailbox *mbox = steal_mailbox_array_[thief];
+        c.put_buffered(mbox, &m, offsetof(steal_mailbox, status), thief);
+        c.put_value((long *)&mbox->status, status, thief);
+
+        g_prof->n_served_steal_requests += 1;
+
+        MADI_DPUTSR1("steal request from %zu: %ld", thief, status);
+    }
+}
+
+void worker::reset_lifelines()
+{
+    if (lifeline_local_ == NULL)
+        return;
+
+    lifeline_local_->pending = 0;
+    lifeline_local_->wakeup = 0;
+    for (int k = 0; k < lifeline_state::MAX_LIFELINES; k++)
+        lifeline_local_->requests[k] = 0;
+
+    lifeline_sleeping_ = false;
+    lifeline_victim_ = -1;
+    n_lifeline_failures_ = 0;
 }
 
 }
@@ -255,6 +588,7 @@ __attribute__((noinline))
 void madi_worker_do_resume_remote_context_1(uth_comm& c,
                                             uth_pid_t victim,
                                             taskque *taskq,
+                                            int n_stolen,
                                             taskq_entry *entry,
                                             logger::begin_data bd)
 {
@@ -266,7 +600,7 @@ void madi_worker_do_resume_remote_context_1(uth_comm& c,
     MADI_TENTRY_PRINT(2, entry);
     MADI_CONTEXT_PRINT(2, ctx);
 
-    taskq->unlock(c, victim);
+    madi::end_steal(c, taskq, victim, n_stolen);
 
     logger::end_event<logger::kind::STEAL_SUCCESS>(bd, victim);
 
@@ -284,13 +618,14 @@ void madi_worker_do_resume_remote_context(void *p0, void *p1, void *p2,
     // data pointed from the parameter pointers may be corrupted
     // by stack copy, so we have to copy it to the current stack frame.
 
-    std::tuple<taskq_entry *, uth_pid_t, taskque *, logger::begin_data>& arg =
-        *(std::tuple<taskq_entry *, uth_pid_t, taskque *, logger::begin_data> *)p0;
+    std::tuple<taskq_entry *, uth_pid_t, taskque *, int, logger::begin_data>& arg =
+        *(std::tuple<taskq_entry *, uth_pid_t, taskque *, int, logger::begin_data> *)p0;
 
     taskq_entry entry = *std::get<0>(arg);
     uth_pid_t victim = std::get<1>(arg);
     taskque *taskq = std::get<2>(arg);
-    logger::begin_data bd = std::get<3>(arg);
+    int n_stolen = std::get<3>(arg);
+    logger::begin_data bd = std::get<4>(arg);
 
     iso_space& ispace = madi::proc().ispace();
     uth_comm& c = madi::proc().com();
@@ -323,14 +658,15 @@ void madi_worker_do_resume_remote_context(void *p0, void *p1, void *p2,
 
     logger::end_event<logger::kind::STEAL_TASK_COPY>(bd2, frame_size);
 
-    madi_worker_do_resume_remote_context_1(c, victim, taskq, &entry,
+    madi_worker_do_resume_remote_context_1(c, victim, taskq, n_stolen, &entry,
                                            bd);
 }
 
 __attribute__((noinline))
-void madi_worker_do_resume_remote_context_by_messages_1(steal_rep *rep)
+void madi_worker_do_resume_remote_context_by_messages_1(taskq_entry *entry,
+                                                        uth_pid_t victim,
+                                                        logger::begin_data bd)
 {
-    taskq_entry *entry = &rep->entry;
     MADI_UNUSED uint8_t *frame_base = (uint8_t *)entry->frame_base;
     MADI_UNUSED size_t frame_size = entry->frame_size;
 
@@ -339,11 +675,11 @@ void madi_worker_do_resume_remote_context_by_messages_1(steal_rep *rep)
     MADI_TENTRY_PRINT(2, entry);
     MADI_CONTEXT_PRINT(2, ctx);
 
+    logger::end_event<logger::kind::STEAL_SUCCESS>(bd, victim);
+
     MADI_DPUTSR1("resuming  [%p, %p) (size = %zu) (stolen)",
                  frame_base, frame_base + frame_size, frame_size);
 
-    free(rep); // allocated at reply_steal
-
     madi_resume_context(ctx, frame_size, false);
 }
 
@@ -354,11 +690,16 @@ void madi_worker_do_resume_remote_context_by_messages(
     // data pointed from the parameter pointers may be corrupted
     // by stack copy, so we have to copy it to the current stack frame.
 
-    steal_rep *rep = (steal_rep *)p0;
-    taskq_entry& entry = rep->entry;
-    char *frames       = rep->frames;
+    std::tuple<steal_rep *, uth_pid_t, logger::begin_data>& arg =
+        *(std::tuple<steal_rep *, uth_pid_t, logger::begin_data> *)p0;
 
-    uth_comm& c = madi::proc().com();
+    // the reply is in the worker's buffer, which is not overwritten
+    // until the next steal
+    steal_rep *rep = std::get<0>(arg);
+    uth_pid_t victim = std::get<1>(arg);
+    logger::begin_data bd = std::get<2>(arg);
+
+    taskq_entry entry = rep->entry;
 
     uint8_t *frame_base = (uint8_t *)entry.frame_base;
     size_t frame_size = entry.frame_size;
@@ -368,11 +709,15 @@ void madi_worker_do_resume_remote_context_by_messages(
                  frame_size);
     MADI_TENTRY_PRINT(2, &entry);
 
+    logger::begin_data bd2 = logger::begin_event<logger::kind::STEAL_TASK_COPY>();
+
     // frame copy
-    memcpy(frame_base, frames, frame_size);
+    memcpy(frame_base, rep->frames, frame_size);
+
+    logger::end_event<logger::kind::STEAL_TASK_COPY>(bd2, frame_size);
 
     // resume
-    madi_worker_do_resume_remote_context_by_messages_1(rep);
+    madi_worker_do_resume_remote_context_by_messages_1(&entry, victim, bd);
 }
 
 }
@@ -393,12 +738,165 @@ static size_t select_victim_randomly(uth_comm& c)
     return pid;
 }
 
-static size_t select_victim(uth_comm& c)
+uth_pid_t worker::select_victim_hierarchically(uth_comm& c)
+{
+    size_t n_procs = c.get_n_procs();
+    size_t n_node_victims = node_victims_.size();
+
+    // all processes except me are on this node (or no one is)
+    if (n_node_victims + 1 == n_procs || n_node_victims == 0)
+        return select_victim_randomly(c);
+
+    // steal from the processes on the same node first, and escalate to
+    // remote nodes only after several consecutive failures
+    bool local =
+        n_node_steal_failures_ < uth_options.steal_local_retries &&
+        random_int(1 << 20) < (int)(uth_options.steal_local_prob * (1 << 20));
+
+    if (local)
+        return node_victims_[random_int((int)n_node_victims)];
+
+    uth_pid_t pid;
+    do {
+        pid = select_victim_randomly(c);
+    } while (std::binary_search(node_victims_.begin(), node_victims_.end(),
+                                pid));
+
+    return pid;
+}
+
+uth_pid_t worker::select_victim(uth_comm& c)
+{
+    steal_skipped_ = false;
+
+    if (lifeline_victim_ >= 0) {
+        uth_pid_t pid = (uth_pid_t)lifeline_victim_;
+        lifeline_victim_ = -1;
+        return pid;
+    }
+
+    if (leapfrog_victim_ >= 0) {
+        uth_pid_t pid = (uth_pid_t)leapfrog_victim_;
+        if (--n_leapfrog_steals_ <= 0)
+            leapfrog_victim_ = -1;
+
+        g_prof->n_leapfrog_steals += 1;
+        return pid;
+    }
+
+    if (!victim_history_.empty())
+        return select_victim_with_history(c);
+
+    return select_victim_by_policy(c);
+}
+
+uth_pid_t worker::select_victim_by_policy(uth_comm& c)
 {
-    return select_victim_randomly(c);
+    switch (uth_options.steal_policy) {
+        case STEAL_POLICY_RANDOM:
+            return select_victim_randomly(c);
+        case STEAL_POLICY_HIERARCHICAL:
+            return select_victim_hierarchically(c);
+        default:
+            MADI_DIE("invalid MADM_STEAL_POLICY: %d",
+                     uth_options.steal_policy);
+    }
 }
 
-bool worker::steal_with_lock(taskq_entry *entry,
+// returns n_procs if all the candidates are backing off
+uth_pid_t worker::select_victim_with_history(uth_comm& c)
+{
+    const int max_tries = 4;
+
+    uint64_t now = global_clock::get_local_time();
+    uint64_t hint_ttl = (uint64_t)uth_options.steal_backoff_max * 1000;
+
+    // go back to a victim recently seen with work
+    if (hint_victim_ >= 0) {
+        uth_pid_t pid = (uth_pid_t)hint_victim_;
+        victim_history& h = victim_history_[pid];
+
+        if (now - h.time < hint_ttl && now - h.time >= h.backoff &&
+            random_int(1 << 20) < (int)(uth_options.steal_hint_prob * (1 << 20))) {
+            logger::begin_data bd = logger::begin_event<logger::kind::STEAL_HINT>();
+            logger::end_event<logger::kind::STEAL_HINT>(bd, pid);
+
+            g_prof->n_hinted_steals += 1;
+            return pid;
+        }
+    }
+
+    for (int i = 0; i < max_tries; i++) {
+        uth_pid_t pid = select_victim_by_policy(c);
+        victim_history& h = victim_history_[pid];
+
+        if (now - h.time >= h.backoff)
+            return pid;
+
+        logger::begin_data bd = logger::begin_event<logger::kind::STEAL_BACKOFF_SKIP>();
+        logger::end_event<logger::kind::STEAL_BACKOFF_SKIP>(bd, pid);
+
+        g_prof->n_backoff_skips += 1;
+    }
+
+    steal_skipped_ = true;
+    return c.get_n_procs();
+}
+
+void worker::notify_steal_result(uth_pid_t victim, steal_result result,
+                                 int depth)
+{
+    bool success = (result == STEAL_RESULT_SUCCESS);
+
+    // work of the awaited subtree is found
+    if (success && leapfrog_victim_ == (long)victim)
+        leapfrog_victim_ = -1;
+
+    switch (result) {
+        case STEAL_RESULT_SUCCESS: g_prof->n_success_steals += 1;     break;
+        case STEAL_RESULT_ABORTED: g_prof->n_aborted_steals += 1;     break;
+        case STEAL_RESULT_LOCKED:  g_prof->n_failed_steals_lock += 1; break;
+        case STEAL_RESULT_EMPTY:   g_prof->n_failed_steals_empty += 1; break;
+    }
+
+    if (uth_options.steal_policy == STEAL_POLICY_HIERARCHICAL) {
+        bool local = std::binary_search(node_victims_.begin(),
+                                        node_victims_.end(), victim);
+
+        if (local && !success)
+            n_node_steal_failures_ += 1;
+        else
+            n_node_steal_failures_ = 0;
+    }
+
+    if (!victim_history_.empty()) {
+        victim_history& h = victim_history_[victim];
+
+        h.depth  = depth;
+        h.result = result;
+        h.time   = global_clock::get_local_time();
+
+        // exponential backoff on consecutive failures
+        if (success) {
+            h.backoff = 0;
+        } else if (h.backoff == 0) {
+            h.backoff = (uint64_t)uth_options.steal_backoff * 1000;
+        } else {
+            h.backoff = std::min(h.backoff * 2,
+                                 (uint64_t)uth_options.steal_backoff_max * 1000);
+        }
+
+        // a locked victim is backing off, so only a victim whose work
+        // has been taken is worth going back to
+        if (success && depth > 0)
+            hint_victim_ = victim;
+        else if (hint_victim_ == (long)victim)
+            hint_victim_ = -1;
+    }
+}
+
+bool worker::steal_with_lock(taskq_entry *entries_buf,
+                             int *n_entries,
                              uth_pid_t *victim,
                              taskque **taskq_ptr)
 {
@@ -407,15 +905,24 @@ bool worker::steal_with_lock(taskq_entry *entry,
     size_t target = select_victim(c);
     *victim = target;
 
-    taskq_entry *entries = taskq_entries_array_[target];
+    if (target == c.get_n_procs())
+        return false;
+
     taskque *taskq = taskq_array_[target];
 
-    if (uth_options.aborting_steal) {
-        bool do_abort = taskq->empty(c, target, taskq_buf_);
+    int max_entries = 1;
+    int size = -1;
+
+    if (uth_options.aborting_steal || uth_options.steal_batch > 1) {
+        size = taskq->size(c, target, taskq_buf_);
 
-        if (do_abort) {
+        if (uth_options.aborting_steal && size <= 0) {
+            notify_steal_result(target, STEAL_RESULT_ABORTED, 0);
             return false;
         }
+
+        // steal up to half of the entries in the victim's queue
+        max_entries = std::max(1, std::min(size / 2, uth_options.steal_batch));
     }
 
     bool success;
@@ -423,22 +930,116 @@ bool worker::steal_with_lock(taskq_entry *entry,
 
     if (!success) {
         MADI_DPUTSR1("steal lock failed");
+        notify_steal_result(target, STEAL_RESULT_LOCKED, size);
         return false;
     }
 
-    success = taskq->steal(c, target, entries, entry, taskq_buf_);
+    int n = taskq->steal_batch(c, target, entries_buf, max_entries,
+                               taskq_buf_);
 
-    if (!success) {
+    if (n == 0) {
         MADI_DPUTSR1("steal task empty");
         taskq->unlock(c, target);
 
+        notify_steal_result(target, STEAL_RESULT_EMPTY, 0);
         return false;
     }
 
+    notify_steal_result(target, STEAL_RESULT_SUCCESS,
+                        taskq_->observed_size(taskq_buf_));
+
+    *n_entries = n;
     *taskq_ptr = taskq;  // for unlock when task stack is transfered
     return true;
 }
 
+bool worker::steal_without_lock(taskq_entry *entries_buf,
+                                int *n_entries,
+                                uth_pid_t *victim,
+                                taskque **taskq_ptr)
+{
+    uth_comm& c = madi::proc().com();
+
+    size_t target = select_victim(c);
+    *victim = target;
+
+    if (target == c.get_n_procs())
+        return false;
+
+    taskque *taskq = taskq_array_[target];
+
+    int n = taskq->steal_lockfree(c, target, entries_buf,
+                                  uth_options.steal_batch, taskq_buf_);
+
+    if (n == 0) {
+        MADI_DPUTSR1("steal task empty");
+        notify_steal_result(target, STEAL_RESULT_EMPTY, 0);
+        return false;
+    }
+
+    // the state is read before the entries are claimed
+    notify_steal_result(target, STEAL_RESULT_SUCCESS,
+                        std::max(0, taskq_->observed_size(taskq_buf_) - n));
+
+    *n_entries = n;
+    *taskq_ptr = taskq;  // for end_steal when task stack is transfered
+    return true;
+}
+
+// copies the stack frame of an entry in the uni-address region of owner
+// to the local heap, and makes the entry refer to the evacuated context.
+// a frame of another process is fetched by get_nbi, so the caller has to
+// fence before using it. other entries are left as they are.
+void worker::evacuate_entry(uth_comm& c, taskq_entry& e, uth_pid_t owner)
+{
+    if (e.stack_top != 0)
+        return;
+
+    uth_pid_t me = c.get_pid();
+    size_t size = offsetof(saved_context, partial_stack) + e.frame_size;
+
+    saved_context *sctx = alloc_suspended(size);
+    sctx->is_main_task = false;
+    sctx->ip = NULL;
+    sctx->sp = NULL;
+    sctx->ctx = (context *)e.frame_base;
+    sctx->stack_top = e.frame_base;
+    sctx->stack_size = e.frame_size;
+
+    if (owner == me)
+        memcpy(sctx->partial_stack, e.frame_base, e.frame_size);
+    else
+        c.reg_get_nbi(sctx->partial_stack, e.frame_base, e.frame_size,
+                      owner);
+
+    e.pid        = me;
+    e.stack_top  = e.frame_base;
+    e.frame_base = (uint8_t *)sctx;
+    e.frame_size = size;
+}
+
+void worker::push_stolen_entries(taskq_entry *entries, int n_entries,
+                                 uth_pid_t victim)
+{
+    // the stack frames of the extra entries remain in the uni-address
+    // region of the victim, so they are evacuated to the local heap
+    // before the victim's taskq is unlocked. they are pushed as evacuated
+    // threads, which can be resumed or stolen again at any place.
+    // range tasks are pushed as they are.
+    uth_comm& c = madi::proc().com();
+
+    for (int i = 0; i < n_entries; i++)
+        evacuate_entry(c, entries[i], victim);
+
+    c.fence();
+
+    for (int i = 0; i < n_entries; i++)
+        taskq_->push(c, entries[i]);
+
+    answer_lifelines(c);
+    serve_steal_requests(c);
+}
+
 void resume_remote_evacuated_context(saved_context *sctx,
                                      suspended_entry *se)
 {
@@ -451,7 +1052,7 @@ void resume_remote_evacuated_context(saved_context *sctx,
 
 void resume_remote_context(saved_context *sctx,
                            std::tuple<taskq_entry *, uth_pid_t,
-                                      taskque *, logger::begin_data> *arg)
+                                      taskque *, int, logger::begin_data> *arg)
 {
     taskq_entry *entry = std::get<0>(*arg);
 
@@ -472,12 +1073,25 @@ bool worker::steal_by_rdmas()
 {
     uth_pid_t victim;
 
-    taskq_entry& stolen_entry = *taskq_entry_buf_;
+    taskq_entry& stolen_entry = taskq_entry_buf_[0];
     taskque *taskq;
+    int n_stolen = 0;
 
     logger::begin_data bd = logger::begin_event<logger::kind::STEAL_SUCCESS>();
 
-    bool success = steal_with_lock(&stolen_entry, &victim, &taskq);
+    bool success;
+    if (uth_options.taskq_lockfree)
+        success = steal_without_lock(taskq_entry_buf_, &n_stolen, &victim,
+                                     &taskq);
+    else
+        success = steal_with_lock(taskq_entry_buf_, &n_stolen, &victim,
+                                  &taskq);
+
+    // no victim is selected (all the candidates are backing off)
+    if (victim == madi::proc().com().get_n_procs()) {
+        logger::end_event<logger::kind::STEAL_BACKOFF_SKIP>(bd, victim);
+        return false;
+    }
 
     if (success) {
         // next_steal() is called when stolen thread resumed.
@@ -490,20 +1104,35 @@ bool worker::steal_by_rdmas()
     if (success) {
         logger::checkpoint<logger::kind::WORKER_SCHED>();
 
+        // the oldest entry is resumed, and the others are kept
+        // in the local taskq
+        if (n_stolen > 1)
+            push_stolen_entries(taskq_entry_buf_ + 1, n_stolen - 1, victim);
+
         // switch to the stolen task
         MADI_DPUTSB2("resuming a stolen task");
 
-        if (stolen_entry.stack_top == 0) {
+        if (is_range_entry(stolen_entry)) {
+            // no stack frame is transferred for a range task
+            uth_comm& c = madi::proc().com();
+            end_steal(c, taskq, victim, n_stolen);
+
+            logger::end_event<logger::kind::STEAL_SUCCESS>(bd, victim);
+
+            taskq_entry entry = stolen_entry;
+            run_range_task(entry);
+        } else if (stolen_entry.stack_top == 0) {
             // the stack frame is in the uni-address region
-            std::tuple<taskq_entry *, uth_pid_t, taskque *, logger::begin_data>
-                arg(&stolen_entry, victim, taskq, bd);
+            std::tuple<taskq_entry *, uth_pid_t, taskque *, int,
+                       logger::begin_data>
+                arg(&stolen_entry, victim, taskq, n_stolen, bd);
 
             suspend(resume_remote_context, &arg);
         } else {
             // no need to protect the taskq lock until the stack copy is completed
             // because the stack has already been evacuated from the uni-address region
             uth_comm& c = madi::proc().com();
-            taskq->unlock(c, victim);
+            end_steal(c, taskq, victim, n_stolen);
 
             suspended_entry se;
             se.base      = stolen_entry.frame_base;
@@ -520,19 +1149,23 @@ bool worker::steal_by_rdmas()
 
 void handle_steal_reply(int tag, int pid, void *p, size_t size, aminfo *info)
 {
+    worker& w = madi::current_worker();
+
     steal_rep *rep = reinterpret_cast<steal_rep *>(p);
     steal_req *req = rep->req_ptr;
 
     if (rep->success) {
-        // deallocated at madi_worker_do_resume_remote_context_by_messages_1
-        steal_rep *rep1 = (steal_rep *)malloc(size);
-        memcpy(rep1, rep, size);
+        // the message buffer is reused by the communication layer
+        std::vector<uint8_t>& buf = w.steal_result_buf_;
+        if (buf.size() < size)
+            buf.resize(size);
 
-        req->result_rep = rep1;
-    } else {
-        req->result_rep = NULL;
+        memcpy(buf.data(), rep, size);
     }
 
+    req->success = rep->success;
+    req->locked  = rep->locked;
+    req->depth   = rep->depth;
     req->done = true;
 }
 
@@ -545,102 +1178,218 @@ void handle_steal_request(int tag, int pid, void *p, size_t size, aminfo *info)
 
     steal_req *req = reinterpret_cast<steal_req *>(p);
 
-    bool success = taskq.trylock(c, me);
+    // the owner is the only process that accesses the entries in this
+    // handler, but remote thieves may still use the RDMA-based protocol
+    bool lockfree = uth_options.taskq_lockfree;
 
-    if (!success) {
-        steal_rep rep;
-        rep.req_ptr = req->req_ptr;
-        rep.success = false;
-        c.amreply(uth_comm::AM_STEAL_REP, &rep, sizeof(rep), info);
+    steal_rep fail_rep;
+    fail_rep.req_ptr = req->req_ptr;
+    fail_rep.success = false;
+    fail_rep.locked = false;
+    fail_rep.has_frames = false;
+    fail_rep.depth = taskq.local_size();
+
+    if (!lockfree && !taskq.trylock(c, me)) {
+        fail_rep.locked = true;
+        c.amreply(uth_comm::AM_STEAL_REP, &fail_rep, sizeof(fail_rep), info);
 
-        MADI_DP((int)success);
+        MADI_DPUTSR1("steal request from %d: lock failed", pid);
         return;
     }
 
     taskq_entry entry;
-    success = taskq.local_steal(&entry);
+    bool success = taskq.local_steal(&entry);
 
     if (success) {
-        // make msg body
-        size_t rep_size = offsetof(steal_rep, frames) + entry.frame_size;
-        steal_rep *rep = (steal_rep *)malloc(rep_size);
-        rep->req_ptr = req->req_ptr;
-        rep->success = true;
-        rep->entry   = entry;
-        memcpy(rep->frames, entry.frame_base, entry.frame_size);
-
-        taskq.unlock(c, me);
-
-        // reply msg
-        c.amreply(uth_comm::AM_STEAL_REP, rep, rep_size, info);
+        // stack frames in the uni-address region are sent with the entry.
+        // an evacuated context may live in another process, so it is
+        // fetched by the thief in the same way as RDMA-based stealing
+        // (and so is the descriptor of a range task).
+        // the frames follow the header in the message, and are copied
+        // only once into the send buffer before the taskq is unlocked.
+        bool has_frames = (entry.stack_top == 0);
+        size_t frames_size = has_frames ? entry.frame_size : 0;
 
-        free(rep);
+        steal_rep rep;
+        rep.req_ptr    = req->req_ptr;
+        rep.success    = true;
+        rep.locked     = false;
+        rep.has_frames = has_frames;
+        rep.depth      = taskq.local_size();
+        rep.entry      = entry;
+
+        c.amreply(uth_comm::AM_STEAL_REP, &rep, offsetof(steal_rep, frames),
+                  entry.frame_base, frames_size, info);
+
+        if (!lockfree)
+            taskq.unlock(c, me);
     } else {
-        taskq.unlock(c, me);
+        if (!lockfree)
+            taskq.unlock(c, me);
 
-        steal_rep rep;
-        rep.req_ptr = req->req_ptr;
-        rep.success = false;
-        c.amreply(uth_comm::AM_STEAL_REP, &rep, sizeof(rep), info);
+        fail_rep.depth = 0;
+        c.amreply(uth_comm::AM_STEAL_REP, &fail_rep, sizeof(fail_rep), info);
     }
 
-
-    MADI_DP((int)success);
+    MADI_DPUTSR1("steal request from %d: %d", pid, (int)success);
 }
 
 void resume_remote_context_by_messages(saved_context *sctx,
-                                       steal_rep *rep)
+                                       std::tuple<steal_rep *, uth_pid_t,
+                                                  logger::begin_data> *arg)
 {
     worker& w = madi::current_worker();
-    taskq_entry *entry = &rep->entry;
+    steal_rep *rep = std::get<0>(*arg);
 
     MADI_ASSERT(sctx != NULL);
 
-    /* w.waitq().push_back(sctx); */
+    // steal should occur only on the main thread
+    MADI_ASSERT(w.is_main_task_);
 
     w.is_main_task_ = false;
 
-    uint8_t *next_stack_top = (uint8_t *)entry->frame_base;
+    uint8_t *next_stack_top = (uint8_t *)rep->entry.frame_base;
     MADI_EXECUTE_ON_STACK(madi_worker_do_resume_remote_context_by_messages,
-                          sctx, rep, NULL, NULL,
+                          arg, NULL, NULL, NULL,
                           next_stack_top);
 }
 
 bool worker::steal_by_messages()
 {
     uth_comm& c = madi::proc().com();
-  
-    size_t target = select_victim(c);
+
+    uth_pid_t target = select_victim(c);
+
+    if (target == c.get_n_procs())
+        return false;
+
+    logger::begin_data bd = logger::begin_event<logger::kind::STEAL_SUCCESS>();
 
     steal_req req;
-    req.done       = false;
-    req.result_rep = NULL;
+    req.req_ptr = &req;
+    req.done    = false;
+    req.success = false;
+    req.locked  = false;
+    req.depth   = -1;
 
-    steal_req *arg = &req;
-    c.amrequest(uth_comm::AM_STEAL_REQ, &arg, sizeof(arg), target);
+    c.amrequest(uth_comm::AM_STEAL_REQ, &req, sizeof(req), target);
 
+    // steal requests from other thieves are served while waiting
     while (!req.done)
+        c.poll();
+
+    bool success = req.success;
+
+    steal_result result = success    ? STEAL_RESULT_SUCCESS :
+                          req.locked ? STEAL_RESULT_LOCKED :
+                                       STEAL_RESULT_EMPTY;
+    notify_steal_result(target, result, req.depth);
+
+    if (!success) {
+        logger::end_event<logger::kind::STEAL_FAIL>(bd, target);
+        return false;
+    }
+
+    logger::checkpoint<logger::kind::WORKER_SCHED>();
+
+    steal_rep *rep = reinterpret_cast<steal_rep *>(steal_result_buf_.data());
+
+    if (rep->has_frames) {
+        std::tuple<steal_rep *, uth_pid_t, logger::begin_data>
+            arg(rep, target, bd);
+
+        suspend(resume_remote_context_by_messages, &arg);
+    } else if (is_range_entry(rep->entry)) {
+        logger::end_event<logger::kind::STEAL_SUCCESS>(bd, target);
+
+        taskq_entry entry = rep->entry;
+        run_range_task(entry);
+    } else {
+        suspended_entry se;
+        se.base      = rep->entry.frame_base;
+        se.size      = rep->entry.frame_size;
+        se.pid       = rep->entry.pid;
+        se.stack_top = rep->entry.stack_top;
+
+        suspend(resume_remote_evacuated_context, &se);
+    }
+
+    return true;
+}
+
+bool worker::steal_by_queue()
+{
+    uth_comm& c = madi::proc().com();
+    uth_pid_t me = c.get_pid();
+    size_t n_procs = c.get_n_procs();
+
+    uth_pid_t target = select_victim(c);
+
+    if (target == n_procs)
+        return false;
+
+    logger::begin_data bd = logger::begin_event<logger::kind::STEAL_SUCCESS>();
+
+    steal_mailbox *mbox = steal_mailbox_array_[me];
+    mbox->status = STEAL_GRANT_WAITING;
+
+    steal_request_ring *r = steal_ring_array_[target];
+    long ticket = c.fetch_and_add((long *)&r->tail, 1L, target);
+    c.put_value((long *)&r->slots[ticket % n_procs], (long)me + 1, target);
+
+    // requests to this process are answered while waiting,
+    // so that thieves waiting for each other do not deadlock
+    while (mbox->status == STEAL_GRANT_WAITING) {
+        serve_steal_requests(c);
         MADI_UTH_COMM_POLL();
+    }
 
-    bool success = (req.result_rep != NULL);
+    comm::threadsafe::rbarrier();
 
-    if (success) {
-        steal_rep *rep = req.result_rep;
+    bool success = (mbox->status == STEAL_GRANT_SUCCESS);
+
+    notify_steal_result(target,
+                        success ? STEAL_RESULT_SUCCESS : STEAL_RESULT_EMPTY,
+                        (int)mbox->depth);
 
-        // work stealing succeeds
-        suspend(resume_remote_context_by_messages, rep);
+    if (!success) {
+        logger::end_event<logger::kind::STEAL_FAIL>(bd, target);
+        return false;
     }
 
-    return success;
+    logger::end_event<logger::kind::STEAL_SUCCESS>(bd, target);
+    logger::checkpoint<logger::kind::WORKER_SCHED>();
+
+    if (is_range_entry(mbox->entry)) {
+        taskq_entry entry = mbox->entry;
+        run_range_task(entry);
+        return true;
+    }
+
+    // the victim has always evacuated the stack frame
+    suspended_entry se;
+    se.base      = mbox->entry.frame_base;
+    se.size      = mbox->entry.frame_size;
+    se.pid       = mbox->entry.pid;
+    se.stack_top = mbox->entry.stack_top;
+
+    suspend(resume_remote_evacuated_context, &se);
+
+    return true;
 }
 
 bool worker::steal()
 {
-#if 1
-    return steal_by_rdmas();
-#else
-    return steal_by_messages();
-#endif
+    switch (uth_options.steal_mode) {
+        case STEAL_MODE_RDMA:
+            return steal_by_rdmas();
+        case STEAL_MODE_MESSAGE:
+            return steal_by_messages();
+        case STEAL_MODE_QUEUE:
+            return steal_by_queue();
+        default:
+            MADI_DIE("invalid MADM_STEAL_MODE: %d", uth_options.steal_mode);
+    }
 }
 
 }
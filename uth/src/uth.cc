@@ -4,6 +4,7 @@
 #include "madi-inl.h"
 #include "future-inl.h"
 #include "uth_options.h"
+#include "madm_logger.h"
 
 namespace madm {
 namespace uth {
@@ -30,5 +31,21 @@ namespace uth {
         madi::uth_options_print(f);
     }
 
+    static uint64_t logger_t_begin = 0;
+
+    void logger_clear()
+    {
+        madi::barrier();
+        madi::logger::clear();
+        logger_t_begin = madi::global_clock::get_time();
+    }
+
+    void logger_print_stat()
+    {
+        madi::barrier();
+        uint64_t t_end = madi::global_clock::get_time();
+        madi::logger::flush_and_print_stat(logger_t_begin, t_end);
+    }
+
 }
 }
@@ -1,5 +1,6 @@
 #include "uth_comm.h"
 #include "uth_comm-inl.h"
+#include "uth_options.h"
 
 #include <madm_comm.h>
 
@@ -30,12 +31,23 @@ namespace madi {
 
     bool uth_comm::initialize(int& argc, char **&argv)
     {
-        comm::initialize_with_amhandler(argc, argv, amhandle);
+        // active messages are used only by message-based stealing.
+        // without a handler, the comm layer does not probe for them at
+        // every poll, and leaves the probe to a progress thread if any
+        if (uth_options.steal_mode == STEAL_MODE_MESSAGE)
+            comm::initialize_with_amhandler(argc, argv, amhandle);
+        else
+            comm::initialize(argc, argv);
 
         buffer_size_ = 8192;
 
         buffer_ = comm::rma_malloc<uint8_t>(buffer_size_);
 
+        // a progress thread makes progress on RMA operations,
+        // but active messages are handled only by polling
+        poll_at_create_ = !comm::has_progress_thread() ||
+                          uth_options.steal_mode == STEAL_MODE_MESSAGE;
+
         initialized_ = true;
 
         return true;
@@ -233,6 +245,19 @@ namespace madi {
         comm::reg_get(rdma_id_, dst, src, size, target);
     }
 
+    void uth_comm::reg_get_nbi(void *dst, void *src, size_t size,
+                               uth_pid_t target)
+    {
+        MADI_ASSERT(rdma_id_ != -1);
+
+        comm::reg_get_nbi(rdma_id_, dst, src, size, target);
+    }
+
+    void uth_comm::fence()
+    {
+        comm::fence();
+    }
+
     void uth_comm::barrier()
     {
         comm::barrier();
@@ -259,5 +284,11 @@ namespace madi {
     {
         comm::amreply(tag, p, size, info);
     }
+
+    void uth_comm::amreply(int tag, void *p, size_t size, void *p2,
+                           size_t size2, aminfo *info)
+    {
+        comm::amreply(tag, p, size, p2, size2, info);
+    }
 }
 
@@ -16,6 +16,17 @@ namespace madi {
         0,                  // profile
         0,                  // steal_log
         1,                  // aborting_steal
+        0,                  // steal_policy
+        0.9,                // steal_local_prob
+        4,                  // steal_local_retries
+        1,                  // steal_batch
+        0,                  // taskq_lockfree
+        0,                  // steal_mode
+        0,                  // lifeline_steals
+        0,                  // steal_backoff (us)
+        1000,               // steal_backoff_max (us)
+        0.5,                // steal_hint_prob
+        0,                  // leapfrog_steals
     };
 
     template <class T>
@@ -37,6 +48,15 @@ namespace madi {
         }
     }
 
+    template <>
+    void set_option<double>(const char *name, double *value) {
+        char *s = getenv(name);
+
+        if (s != NULL) {
+            *value = atof(s);
+        }
+    }
+
     template <class T>
     void set_option_coll(const char *name, T *value) {
         int rank;
@@ -57,6 +77,26 @@ namespace madi {
         set_option_coll("MADM_PROFILE", &uth_options.profile);
         set_option_coll("MADM_STEAL_LOG", &uth_options.steal_log);
         set_option_coll("MADM_ABORTING_STEAL", &uth_options.aborting_steal);
+        set_option_coll("MADM_STEAL_POLICY", &uth_options.steal_policy);
+        set_option_coll("MADM_STEAL_LOCAL_PROB", &uth_options.steal_local_prob);
+        set_option_coll("MADM_STEAL_LOCAL_RETRIES",
+                        &uth_options.steal_local_retries);
+        set_option_coll("MADM_STEAL_BATCH", &uth_options.steal_batch);
+
+        if (uth_options.steal_batch < 1)
+            uth_options.steal_batch = 1;
+
+        set_option_coll("MADM_TASKQ_LOCKFREE", &uth_options.taskq_lockfree);
+        set_option_coll("MADM_STEAL_MODE", &uth_options.steal_mode);
+        set_option_coll("MADM_LIFELINE_STEALS", &uth_options.lifeline_steals);
+        set_option_coll("MADM_STEAL_BACKOFF", &uth_options.steal_backoff);
+        set_option_coll("MADM_STEAL_BACKOFF_MAX",
+                        &uth_options.steal_backoff_max);
+        set_option_coll("MADM_STEAL_HINT_PROB", &uth_options.steal_hint_prob);
+        set_option_coll("MADM_LEAPFROG_STEALS", &uth_options.leapfrog_steals);
+
+        if (uth_options.steal_backoff_max < uth_options.steal_backoff)
+            uth_options.steal_backoff_max = uth_options.steal_backoff;
 
         long page_size = sysconf(_SC_PAGE_SIZE);
         uth_options.page_size = static_cast<size_t>(page_size);
@@ -74,11 +114,33 @@ namespace madi {
                 ", MADM_PROFILE = %d"
                 ", MADM_STEAL_LOG = %d"
                 ", MADM_ABORTING_STEAL = %d"
+                ", MADM_STEAL_POLICY = %d"
+                ", MADM_STEAL_LOCAL_PROB = %g"
+                ", MADM_STEAL_LOCAL_RETRIES = %d"
+                ", MADM_STEAL_BATCH = %d"
+                ", MADM_TASKQ_LOCKFREE = %d"
+                ", MADM_STEAL_MODE = %d"
+                ", MADM_LIFELINE_STEALS = %d"
+                ", MADM_STEAL_BACKOFF = %d"
+                ", MADM_STEAL_BACKOFF_MAX = %d"
+                ", MADM_STEAL_HINT_PROB = %g"
+                ", MADM_LEAPFROG_STEALS = %d"
                 "\n",
                 uth_options.stack_size,
                 uth_options.taskq_capacity,
                 uth_options.profile,
                 uth_options.steal_log,
-                uth_options.aborting_steal);
+                uth_options.aborting_steal,
+                uth_options.steal_policy,
+                uth_options.steal_local_prob,
+                uth_options.steal_local_retries,
+                uth_options.steal_batch,
+                uth_options.taskq_lockfree,
+                uth_options.steal_mode,
+                uth_options.lifeline_steals,
+                uth_options.steal_backoff,
+                uth_options.steal_backoff_max,
+                uth_options.steal_hint_prob,
+                uth_options.leapfrog_steals);
     }
 }